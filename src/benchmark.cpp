@@ -0,0 +1,143 @@
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+#include "librrd.h"
+#include "librrd_proc.h"
+
+// collectors as previously used by the example, for comparison
+
+template <class T>
+T stringToNumber(const std::string& str) {
+    assert(!str.empty());
+
+    T number = 0;
+    std::stringstream sstr(str);
+    sstr >> number;
+    assert(sstr);
+
+    return number;
+}
+
+/// return memory usage
+using meminfo_t = std::tuple<double, double, double>;
+meminfo_t get_meminfo() {
+    std::ifstream file("/proc/meminfo");
+
+    rrd_data_point::data_point mem_available(0.0);
+    rrd_data_point::data_point mem_buffers(0.0);
+    rrd_data_point::data_point mem_cached(0.0);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream sstr(line);
+        std::string key, value, unit;
+        sstr >> key >> value >> unit;
+
+        if (key == "MemAvailable:") {
+            mem_available = stringToNumber<rrd_data_point::data_point>(value);
+        } else if (key == "Buffers:") {
+            mem_buffers = stringToNumber<rrd_data_point::data_point>(value);
+        } else if (key == "Cached:") {
+            mem_cached = stringToNumber<rrd_data_point::data_point>(value);
+            break;
+        }
+    }
+
+    return std::make_tuple(mem_available, mem_buffers, mem_cached);
+}
+
+/// return CPU usage
+/// note: first value is bogus (average since startup)
+double get_cpu_usage() {
+    using value_t = unsigned long long;
+    static value_t last_total = 0.0;
+    static value_t last_work = 0.0;
+
+    std::ifstream file("/proc/stat");
+    std::string line;
+    std::getline(file, line);
+
+    std::stringstream sstr(line);
+    std::string tmp; // "cpu" in first line
+    value_t user, nice, system, idle, iowait, irq, softirq;
+    sstr >> tmp >> user >> nice >> system >> idle >> iowait >> irq >> softirq;
+
+    value_t cur_total = user + nice + system + idle + iowait + irq + softirq;
+    value_t cur_work = cur_total - idle;
+
+    value_t total = cur_total - last_total;
+    value_t work = cur_work - last_work;
+
+    last_total = cur_total;
+    last_work = cur_work;
+
+    return (work / (double)total) * 100.0;
+}
+
+/// measure samples per second of a collector
+void benchmark(std::string const& name, std::function<void()> sample) {
+    const auto duration = std::chrono::seconds(1);
+
+    unsigned long long samples = 0;
+    const auto start = std::chrono::steady_clock::now();
+    auto now = start;
+    while (now - start < duration) {
+        // check time only every few samples
+        for (int i = 0; i < 100; ++i) {
+            sample();
+        }
+        samples += 100;
+        now = std::chrono::steady_clock::now();
+    }
+
+    const double seconds = std::chrono::duration<double>(now - start).count();
+    std::cout << name << ": " << (unsigned long long)(samples / seconds) << " samples/s" << std::endl;
+}
+
+int main() {
+    volatile double sink = 0.0;
+
+    benchmark("example get_cpu_usage() (overall only)", [&sink]() {
+        sink = get_cpu_usage();
+    });
+    rrd_proc_cpu cpu;
+    benchmark("rrd_proc_cpu (overall and " + std::to_string(cpu.names().size() - 1) + " cores)", [&cpu, &sink]() {
+        cpu.sample();
+        sink = cpu.values()[0];
+    });
+
+    benchmark("example get_meminfo()", [&sink]() {
+        sink = std::get<0>(get_meminfo());
+    });
+    rrd_proc_meminfo mem(std::vector<std::string>{"MemAvailable", "Buffers", "Cached"});
+    benchmark("rrd_proc_meminfo", [&mem, &sink]() {
+        mem.sample();
+        sink = mem.values()[0];
+    });
+
+    rrd_proc_diskstats disk;
+    benchmark("rrd_proc_diskstats (" + std::to_string(disk.names().size() / 2) + " devices)", [&disk, &sink]() {
+        disk.sample();
+        sink = disk.values().empty() ? 0.0 : disk.values()[0];
+    });
+    rrd_proc_netdev net;
+    benchmark("rrd_proc_netdev (" + std::to_string(net.names().size() / 2) + " interfaces)", [&net, &sink]() {
+        net.sample();
+        sink = net.values().empty() ? 0.0 : net.values()[0];
+    });
+
+    // sampling including feeding all series into their databases
+    std::vector<rrd_data> cpu_data = cpu.create_data(std::list<rrd_archive>{
+        rrd_archive("all", 1, 60, rrd_archive::AVG),
+        rrd_archive("avg", 60, 60, rrd_archive::AVG)
+    });
+    benchmark("rrd_proc_cpu with rrd_data::add() per core", [&cpu, &cpu_data]() {
+        cpu.sample();
+        cpu.add(cpu_data, rrd_data_point::clock::now());
+    });
+}
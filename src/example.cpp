@@ -1,78 +1,38 @@
-#include <cassert>
-#include <fstream>
 #include <iostream>
-#include <sstream>
 #include <string>
-#include <thread>
-#include <tuple>
+#include <vector>
 
 #include "librrd.h"
-
-template <class T>
-T stringToNumber(const std::string& str) {
-    assert(!str.empty());
-
-    T number = 0;
-    std::stringstream sstr(str);
-    sstr >> number;
-    assert(sstr);
-
-    return number;
-}
-
-/// return memory usage
-using meminfo_t = std::tuple<double, double, double>;
-meminfo_t get_meminfo() {
-    std::ifstream file("/proc/meminfo");
-
-    rrd_data_point::data_point mem_available(0.0);
-    rrd_data_point::data_point mem_buffers(0.0);
-    rrd_data_point::data_point mem_cached(0.0);
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream sstr(line);
-        std::string key, value, unit;
-        sstr >> key >> value >> unit;
-
-        if (key == "MemAvailable:") {
-            mem_available = stringToNumber<rrd_data_point::data_point>(value);
-        } else if (key == "Buffers:") {
-            mem_buffers = stringToNumber<rrd_data_point::data_point>(value);
-        } else if (key == "Cached:") {
-            mem_cached = stringToNumber<rrd_data_point::data_point>(value);
-            break;
-        }
+#include "librrd_proc.h"
+#include "librrd_scheduler.h"
+
+/// periodically sample CPU usage
+rrd_scheduler::task collect_cpu(rrd_scheduler& scheduler, rrd_data& cpu_usage,
+                                std::chrono::seconds interval, int count) {
+    rrd_proc_cpu cpu;
+    cpu.sample(); // first value is unknown, CPU usage is measured between samples
+    rrd_scheduler::periodic timer(scheduler, interval, interval);
+    for (int i = 0; i < count; ++i) {
+        const auto now = co_await timer.next();
+        std::cout << "." << std::flush;
+        cpu.sample();
+        cpu_usage.add(cpu.values()[0], now); // overall CPU usage, without single cores
     }
-
-    return std::make_tuple(mem_available, mem_buffers, mem_cached);
 }
 
-/// return CPU usage
-/// note: first value is bogus (average since startup)
-double get_cpu_usage() {
-    using value_t = unsigned long long;
-    static value_t last_total = 0.0;
-    static value_t last_work = 0.0;
-
-    std::ifstream file("/proc/stat");
-    std::string line;
-    std::getline(file, line);
-
-    std::stringstream sstr(line);
-    std::string tmp; // "cpu" in first line
-    value_t user, nice, system, idle, iowait, irq, softirq;
-    sstr >> tmp >> user >> nice >> system >> idle >> iowait >> irq >> softirq;
-
-    value_t cur_total = user + nice + system + idle + iowait + irq + softirq;
-    value_t cur_work = cur_total - idle;
-
-    value_t total = cur_total - last_total;
-    value_t work = cur_work - last_work;
-
-    last_total = cur_total;
-    last_work = cur_work;
-
-    return (work / (double)total) * 100.0;
+/// periodically sample memory usage
+rrd_scheduler::task collect_mem(rrd_scheduler& scheduler, rrd_data& mem_available,
+                                rrd_data& mem_buffers, rrd_data& mem_cached,
+                                std::chrono::seconds interval, int count) {
+    rrd_proc_meminfo mem(std::vector<std::string>{"MemAvailable", "Buffers", "Cached"});
+    rrd_scheduler::periodic timer(scheduler, interval, interval);
+    for (int i = 0; i < count; ++i) {
+        const auto now = co_await timer.next();
+        mem.sample();
+        mem_available.add(mem.values()[0], now);
+        mem_buffers.add(mem.values()[1], now);
+        mem_cached.add(mem.values()[2], now);
+    }
 }
 
 int main() {
@@ -127,27 +87,16 @@ int main() {
         rrd_archive("avg", steps, rows_other, rrd_archive::AVG)
     });
 
-    (void)get_cpu_usage(); // throw away first value
-    std::this_thread::sleep_for(interval);
-
     std::cout << "creating " << (duration / interval) << " data points, this will take "
 	      << std::chrono::duration_cast<std::chrono::seconds>(duration).count()
 	      << " seconds" << std::endl;
-    for (int i = 0; i < (duration / interval); ++i) {
-        const auto now = rrd_data_point::clock::now();
-        std::cout << "." << std::flush;
-
-        double cpu = get_cpu_usage();
-        cpu_usage.add(cpu, now);
 
-        meminfo_t mem_info = get_meminfo();
-        mem_available.add(std::get<0>(mem_info), now);
-        mem_buffers.add(std::get<1>(mem_info), now);
-        mem_cached.add(std::get<2>(mem_info), now);
-
-        const auto end = rrd_data_point::clock::now();
-        std::this_thread::sleep_for(interval - (end - now));
-    }
+    // all collectors share a single thread
+    rrd_scheduler scheduler;
+    scheduler.spawn(collect_cpu(scheduler, cpu_usage, interval, duration / interval));
+    scheduler.spawn(collect_mem(scheduler, mem_available, mem_buffers, mem_cached,
+                                interval, duration / interval));
+    scheduler.run();
     std::cout << std::endl;
 
     cpu_usage.dump("cpu_usage_");
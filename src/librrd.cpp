@@ -1,13 +1,15 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
-#include <deque>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <limits>
 #include <list>
 #include <memory>
-#include <numeric>
 #include <utility>
+#include <vector>
 
 #include "librrd.h"
 
@@ -16,81 +18,237 @@ rrd_data_point::rrd_data_point(data_point value, time_point time) :
     time_(time) {
 }
 
-rrd_archive::rrd_archive(std::string name, unsigned int steps, unsigned int rows, int cf) :
+rrd_archive::rrd_archive(std::string name, unsigned int steps, unsigned int rows, int cf, double xff) :
     name_(name),
     steps_(steps),
     rows_(rows),
     cf_(cf),
-    archive_() {
+    xff_(xff),
+    unknowns_(0),
+    archive_values_(rows),
+    archive_times_(rows),
+    head_(0),
+    count_(0) {
+    assert(xff_ >= 0.0 && xff_ < 1.0 && "xff must be in [0, 1)");
+    if (steps_ > 1) {
+        values_.reserve(steps_);
+        times_.reserve(steps_);
+    }
 }
 
 void rrd_archive::add(std::shared_ptr<rrd_data_point> data) {
     if (steps_ == 1) {
         // shortcut in case we want to store each PDP
         // without performing any consolidation at all
-        archive_.push_back(*data);
+        push(*data);
     } else {
-        datapoints_.push_back(data);
+        values_.push_back(data->value());
+        times_.push_back(data->time());
+        unknowns_ += data->is_unknown();
 
         // do we need to consolidate our PDPs to an RRA entry?
-        if (datapoints_.size() >= steps_) {
-            LOG("reached max PDPs " << datapoints_.size() << ", consolidating.");
+        if (values_.size() >= steps_) {
+            LOG("reached max PDPs " << values_.size() << ", consolidating.");
             consolidate();
         }
     }
+}
+
+void rrd_archive::push(rrd_data_point const& cdp) {
+    if (rows_ == 0) {
+        return;
+    }
+
+    std::size_t pos = head_ + count_;
+    if (count_ < rows_) {
+        ++count_;
+    } else {
+        // overwrite oldest RRA entry if maximum size reached
+        LOG("reached max rows, overwriting oldest RRA entry.");
+        head_ = (head_ + 1 == rows_) ? 0 : head_ + 1;
+    }
+    if (pos >= rows_) {
+        pos -= rows_;
+    }
+
+    archive_values_[pos] = cdp.value();
+    archive_times_[pos] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        cdp.time().time_since_epoch()).count();
+}
 
-    // remove oldest RRA entry if maximum size exceeded
-    if (archive_.size() > rows_) {
-        LOG("reached max rows, removing oldest RRA: archive.");
-        archive_.pop_front();
+rrd_data_point rrd_archive::entry(std::size_t i) const {
+    assert(i < count_);
+    std::size_t pos = head_ + i;
+    if (pos >= rows_) {
+        pos -= rows_;
     }
+    return rrd_data_point(archive_values_[pos], rrd_data_point::time_point(
+        std::chrono::duration_cast<rrd_data_point::clock::duration>(
+            std::chrono::nanoseconds(archive_times_[pos]))));
+}
+
+std::pair<rrd_span, rrd_span> rrd_archive::spans() const {
+    // entries from the oldest one up to the end of the ring buffer,
+    // followed by the wrapped entries at the beginning of the ring buffer
+    std::size_t first = std::min<std::size_t>(count_, rows_ - head_);
+    return std::make_pair(
+        rrd_span{archive_values_.data() + head_, archive_times_.data() + head_, first},
+        rrd_span{archive_values_.data(), archive_times_.data(), count_ - first});
 }
 
 void rrd_archive::consolidate() {
     // aggregate all PDPs to a new RRA entry
     auto rra = aggregate();
     LOG("aggregated RRA entry for cf " << cf_to_str() << ": " << rra.value());
-    archive_.push_back(rra);
+    push(rra);
 
     // clear list of PDPs after consolidation
-    datapoints_.clear();
+    values_.clear();
+    times_.clear();
+    unknowns_ = 0;
 }
 
 rrd_data_point rrd_archive::aggregate() {
+    // RRA entry is unknown if too many PDPs are unknown (or all of them)
+    if (unknowns_ == values_.size() ||
+        unknowns_ > xff_ * values_.size()) {
+        LOG("too many unknown PDPs: " << unknowns_ << " of " << values_.size());
+        return rrd_data_point(rrd_data_point::unknown, times_.back());
+    }
+
     switch(cf_) {
     case AVG:
         // time of aggregated data points will equal the time of the newest data point
-        return rrd_data_point(sum(), datapoints_.back()->time());
-    case MIN:
+        return rrd_data_point(avg(), times_.back());
+    case MIN: {
         // time of aggregated data points will equal the time of the minimum data point
-        return *min();
-    case MAX:
+        std::size_t i = min();
+        return rrd_data_point(values_[i], times_[i]);
+    }
+    case MAX: {
         // time of aggregated data points will equal the time of the maximum data point
-        return *max();
+        std::size_t i = max();
+        return rrd_data_point(values_[i], times_[i]);
+    }
     default:
         assert(false && "unknown consolidation function");
-        return rrd_data_point(0.0, datapoints_.back()->time());
+        return rrd_data_point(0.0, times_.back());
+    }
+}
+
+// The following functions skip unknown PDPs without branching per element:
+// unknown values are NaN, which compare false to everything (including themselves),
+// so they can be masked out by a select instead of a branch.
+// They process the PDPs in explicit SIMD vectors (GCC vector extensions, SSE2 on x86-64)
+// of two lanes each, using two vectors as independent accumulators.
+
+namespace {
+
+/// two PDP values
+using value_vec = rrd_data_point::data_point __attribute__((vector_size(16)));
+/// two PDP indices, or the mask of comparing two value vectors
+using index_vec = std::int64_t __attribute__((vector_size(16)));
+
+/// number of values per vector
+constexpr std::size_t vec_lanes = sizeof(value_vec) / sizeof(rrd_data_point::data_point);
+/// number of values per loop iteration (two vectors)
+constexpr std::size_t block = 2 * vec_lanes;
+
+/// load vector of consecutive values
+value_vec load(rrd_data_point::data_point const* values) {
+    value_vec v;
+    std::memcpy(&v, values, sizeof(v));
+    return v;
+}
+
+/// return index of the first PDP preferred by the comparison over all others,
+/// unknown PDPs are never preferred, values.size() if all PDPs are unknown
+template <class Compare>
+std::size_t select_index(std::vector<rrd_data_point::data_point> const& values,
+                         rrd_data_point::data_point init, Compare prefer) {
+    const std::size_t size = values.size();
+    const std::int64_t none = size;
+
+    // value and index are selected in a single pass, the comparison is strict
+    // so each lane keeps the first of several equal values
+    value_vec best0 = {init, init};
+    value_vec best1 = best0;
+    index_vec index0 = {none, none};
+    index_vec index1 = index0;
+    index_vec cur0 = {0, 1};
+    index_vec cur1 = {2, 3};
+    std::size_t i = 0;
+    for (; i + block <= size; i += block) {
+        const value_vec v0 = load(values.data() + i);
+        const value_vec v1 = load(values.data() + i + vec_lanes);
+        // lanes without a known value yet take any known value, even one equal to init
+        // (e.g. +inf for the minimum), so a known value always yields a valid index
+        const index_vec better0 = prefer(v0, best0) | ((index0 == none) & (v0 == v0));
+        const index_vec better1 = prefer(v1, best1) | ((index1 == none) & (v1 == v1));
+        best0 = better0 ? v0 : best0;
+        best1 = better1 ? v1 : best1;
+        index0 = better0 ? cur0 : index0;
+        index1 = better1 ? cur1 : index1;
+        cur0 += (std::int64_t)block;
+        cur1 += (std::int64_t)block;
     }
+
+    // combine lanes and remaining values, preferring the lower index for equal values
+    rrd_data_point::data_point result_value = init;
+    std::int64_t result = none;
+    auto combine = [&](rrd_data_point::data_point v, std::int64_t index) {
+        if (index == none) {
+            return;
+        }
+        if (result == none || prefer(v, result_value) || (v == result_value && index < result)) {
+            result_value = v;
+            result = index;
+        }
+    };
+    for (std::size_t l = 0; l < vec_lanes; ++l) {
+        combine(best0[l], index0[l]);
+        combine(best1[l], index1[l]);
+    }
+    for (; i < size; ++i) {
+        combine(values[i], values[i] == values[i] ? (std::int64_t)i : none);
+    }
+    return result;
 }
 
-rrd_data_point::data_point rrd_archive::sum() const {
-    return std::accumulate(datapoints_.begin(), datapoints_.end(), 0.0,
-            [](rrd_data_point::data_point const& sum, std::shared_ptr<rrd_data_point> const& dp) {
-        return sum + dp->value();
-    }) / datapoints_.size();
+} // namespace
+
+rrd_data_point::data_point rrd_archive::avg() const {
+    const std::size_t size = values_.size();
+    value_vec sum0 = {0.0, 0.0};
+    value_vec sum1 = sum0;
+    const value_vec zero = sum0;
+    std::size_t i = 0;
+    for (; i + block <= size; i += block) {
+        const value_vec v0 = load(values_.data() + i);
+        const value_vec v1 = load(values_.data() + i + vec_lanes);
+        sum0 += (v0 == v0) ? v0 : zero;
+        sum1 += (v1 == v1) ? v1 : zero;
+    }
+    sum0 += sum1;
+    rrd_data_point::data_point sum = sum0[0] + sum0[1];
+    for (; i < size; ++i) {
+        const rrd_data_point::data_point v = values_[i];
+        sum += (v == v) ? v : 0.0;
+    }
+    return sum / (size - unknowns_);
 }
 
-std::shared_ptr<rrd_data_point> rrd_archive::min() const {
-    return *std::min_element(datapoints_.begin(), datapoints_.end(),
-            [](std::shared_ptr<rrd_data_point> const& dp1, std::shared_ptr<rrd_data_point> const& dp2) {
-        return dp1->value() < dp2->value();
+std::size_t rrd_archive::min() const {
+    return select_index(values_, std::numeric_limits<rrd_data_point::data_point>::infinity(),
+            [](auto v, auto best) {
+        return v < best;
     });
 }
 
-std::shared_ptr<rrd_data_point> rrd_archive::max() const {
-    return *std::max_element(datapoints_.begin(), datapoints_.end(),
-            [](std::shared_ptr<rrd_data_point> const& dp1, std::shared_ptr<rrd_data_point> const& dp2) {
-        return dp1->value() < dp2->value();
+std::size_t rrd_archive::max() const {
+    return select_index(values_, -std::numeric_limits<rrd_data_point::data_point>::infinity(),
+            [](auto v, auto best) {
+        return v > best;
     });
 }
 
@@ -110,7 +268,7 @@ std::string rrd_archive::cf_to_str() const {
 
 void rrd_archive::dump(std::ostream& out, time_format time_fmt,
                        value_format value_fmt) const {
-    for (auto const& data_point : archive_) {
+    for (auto const& data_point : archive()) {
         // dump time
         switch (time_fmt) {
         case TIME_SINCE_EPOCH:
@@ -129,7 +287,11 @@ void rrd_archive::dump(std::ostream& out, time_format time_fmt,
 
         out << " ";
 
-        // dump value
+        // dump value, unknown values are always dumped as "nan"
+        if (data_point.is_unknown()) {
+            out << "nan" << std::endl;
+            continue;
+        }
         switch (value_fmt) {
         case VAL_DEFAULT:
             out << std::defaultfloat << data_point.value();
@@ -2,11 +2,16 @@
 #define LIBRRD_H_
 
 #include <chrono>
-#include <deque>
+#include <cstddef>
+#include <cstdint>
 #include <ios>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #ifdef DEBUG
 #include <iostream>
@@ -28,10 +33,15 @@ public:
     using clock = std::chrono::system_clock;
     using time_point = std::chrono::time_point<clock>;
 
+    /// value representing an unknown data point (e.g. a failed measurement)
+    static constexpr data_point unknown = std::numeric_limits<data_point>::quiet_NaN();
+
     rrd_data_point(data_point value, time_point time);
 
     /// return value of data point
     data_point value() const { return value_; }
+    /// return whether the value of the data point is unknown
+    bool is_unknown() const { return value_ != value_; }
     /// return time of data point
     time_point time()  const { return time_; }
 
@@ -40,6 +50,16 @@ private:
     time_point time_;
 };
 
+/// contiguous slice of RRA entries, valid until the archive gets modified
+struct rrd_span {
+    /// values of the RRA entries, unknown values are NaN
+    rrd_data_point::data_point const* values;
+    /// times of the RRA entries in nanoseconds since epoch
+    std::int64_t const* timestamps_ns;
+    /// number of RRA entries
+    std::size_t size;
+};
+
 /// round robin archive (RRA) of consolidated data points (CDPs)
 class rrd_archive {
 public:
@@ -68,7 +88,60 @@ public:
     /// duration resolution for dumping archive content
     using dump_resolution = std::chrono::milliseconds;
 
-    rrd_archive(std::string name, unsigned int steps, unsigned int rows, int cf);
+    /// read-only view of all RRA entries, oldest first
+    class entries {
+    public:
+        class const_iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = rrd_data_point;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = rrd_data_point;
+
+            /// helper for operator-> since entries are created on access
+            struct arrow_proxy {
+                rrd_data_point entry;
+                rrd_data_point const* operator->() const { return &entry; }
+            };
+
+            const_iterator(rrd_archive const* rra, std::size_t index) : rra_(rra), index_(index) {}
+
+            rrd_data_point operator*() const { return rra_->entry(index_); }
+            arrow_proxy operator->() const { return arrow_proxy{rra_->entry(index_)}; }
+            const_iterator& operator++() { ++index_; return *this; }
+            const_iterator operator++(int) { const_iterator it(*this); ++index_; return it; }
+            bool operator==(const_iterator const& other) const { return rra_ == other.rra_ && index_ == other.index_; }
+            bool operator!=(const_iterator const& other) const { return !(*this == other); }
+
+        private:
+            rrd_archive const* rra_;
+            std::size_t index_;
+        };
+
+        explicit entries(rrd_archive const& rra) : rra_(&rra) {}
+
+        /// return number of RRA entries
+        std::size_t size() const { return rra_->count_; }
+        /// return whether there are no RRA entries
+        bool empty() const { return rra_->count_ == 0; }
+        /// return i-th oldest RRA entry
+        rrd_data_point operator[](std::size_t i) const { return rra_->entry(i); }
+        /// return oldest RRA entry
+        rrd_data_point front() const { return rra_->entry(0); }
+        /// return newest RRA entry
+        rrd_data_point back() const { return rra_->entry(rra_->count_ - 1); }
+
+        const_iterator begin() const { return const_iterator(rra_, 0); }
+        const_iterator end() const { return const_iterator(rra_, rra_->count_); }
+
+    private:
+        rrd_archive const* rra_;
+    };
+
+    /// create archive, xff (x-files factor) is the fraction of unknown PDPs
+    /// in [0, 1) which may be unknown while the consolidated RRA entry is still known
+    rrd_archive(std::string name, unsigned int steps, unsigned int rows, int cf, double xff = 0.5);
 
     /// add new primary data point (PDPs)
     void add(std::shared_ptr<rrd_data_point> data);
@@ -79,8 +152,15 @@ public:
     unsigned int steps() const { return steps_; }
     /// return maximum number of RRA entries until the oldest gets overwritten
     unsigned int rows()  const { return rows_; }
+    /// return fraction of PDPs that may be unknown for a known RRA entry
+    double xff() const { return xff_; }
+    /// return number of unknown PDPs waiting for consolidation
+    unsigned int unknowns() const { return unknowns_; }
     /// return all RRA entries
-    std::deque<rrd_data_point> const& archive() const { return archive_; }
+    entries archive() const { return entries(*this); }
+    /// return all RRA entries as up to two contiguous spans without copying,
+    /// oldest first, the second span is only non-empty if the ring buffer wrapped
+    std::pair<rrd_span, rrd_span> spans() const;
 
     /// return consolidation function
     int cf() const { return cf_; }
@@ -92,17 +172,22 @@ public:
               value_format value_fmt = VAL_DEFAULT) const;
 
 private:
+    /// append RRA entry, overwriting the oldest one if the archive is full
+    void push(rrd_data_point const& cdp);
+    /// return i-th oldest RRA entry
+    rrd_data_point entry(std::size_t i) const;
+
     /// consolidate PDPs to a new RRA entry
     void consolidate();
     /// aggregate PDPs with the configured consolidation function
     rrd_data_point aggregate();
 
-    /// return sum of all CDPs
-    rrd_data_point::data_point sum() const;
-    /// return minimum of all CDPs
-    std::shared_ptr<rrd_data_point> min() const;
-    /// return maximum of all CDPs
-    std::shared_ptr<rrd_data_point> max() const;
+    /// return average of all known PDPs
+    rrd_data_point::data_point avg() const;
+    /// return index of the first minimum of all known PDPs
+    std::size_t min() const;
+    /// return index of the first maximum of all known PDPs
+    std::size_t max() const;
 
     /// name of the round robin archive (RRA)
     std::string name_;
@@ -112,10 +197,23 @@ private:
     unsigned int rows_;
     /// consolidate function to use for aggregating PDPs to RRA entries
     int cf_;
-    /// primary data points (PDPs)
-    std::deque<std::shared_ptr<rrd_data_point>> datapoints_;
-    /// round robin archive (RRA) of consolidated data points (CDPs)
-    std::deque<rrd_data_point> archive_;
+    /// fraction of PDPs that may be unknown for a known RRA entry
+    double xff_;
+    /// number of unknown PDPs waiting for consolidation
+    unsigned int unknowns_;
+    /// values of primary data points (PDPs) waiting for consolidation
+    std::vector<rrd_data_point::data_point> values_;
+    /// times of primary data points (PDPs) waiting for consolidation
+    std::vector<rrd_data_point::time_point> times_;
+    /// values of the round robin archive (RRA) of consolidated data points (CDPs),
+    /// ring buffer of size rows_
+    std::vector<rrd_data_point::data_point> archive_values_;
+    /// times of the RRA entries in nanoseconds since epoch, ring buffer of size rows_
+    std::vector<std::int64_t> archive_times_;
+    /// position of the oldest RRA entry within the ring buffer
+    std::size_t head_;
+    /// number of RRA entries
+    std::size_t count_;
 };
 
 /// database of multiple RRAs
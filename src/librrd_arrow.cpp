@@ -0,0 +1,108 @@
+#include <string>
+
+#include "librrd_arrow.h"
+
+namespace {
+
+/// child fields of the exported struct
+const char* const child_names[2]   = { "time", "value" };
+const char* const child_formats[2] = { "tsn:UTC", "g" };
+
+/// data owned by an exported schema
+struct schema_private {
+    std::string name;
+    ArrowSchema children[2];
+    ArrowSchema* child_ptrs[2];
+};
+
+/// data owned by an exported child array, separate from the parent
+/// since consumers may move children out of the parent and release them independently
+struct child_array_private {
+    const void* buffers[2];
+};
+
+/// data owned by an exported array
+struct array_private {
+    const void* buffers[1];
+    ArrowArray children[2];
+    ArrowArray* child_ptrs[2];
+};
+
+void release_child_schema(ArrowSchema* schema) {
+    // owned by the parent, just mark as released
+    schema->release = nullptr;
+}
+
+void release_schema(ArrowSchema* schema) {
+    auto priv = static_cast<schema_private*>(schema->private_data);
+    for (ArrowSchema* child : priv->child_ptrs) {
+        if (child->release) {
+            child->release(child);
+        }
+    }
+    delete priv;
+    schema->release = nullptr;
+}
+
+void release_child_array(ArrowArray* array) {
+    // buffers are owned by the archive, only free our bookkeeping
+    delete static_cast<child_array_private*>(array->private_data);
+    array->release = nullptr;
+}
+
+void release_array(ArrowArray* array) {
+    // buffers are owned by the archive, only free our bookkeeping
+    auto priv = static_cast<array_private*>(array->private_data);
+    for (ArrowArray* child : priv->child_ptrs) {
+        if (child->release) {
+            child->release(child);
+        }
+    }
+    delete priv;
+    array->release = nullptr;
+}
+
+} // namespace
+
+void rrd_export_arrow_schema(rrd_archive const& rra, ArrowSchema* schema) {
+    auto priv = new schema_private;
+    priv->name = rra.name();
+    for (int i = 0; i < 2; ++i) {
+        priv->children[i] = ArrowSchema{
+            child_formats[i], child_names[i], nullptr, 0,
+            0, nullptr, nullptr,
+            &release_child_schema, nullptr
+        };
+        priv->child_ptrs[i] = &priv->children[i];
+    }
+
+    *schema = ArrowSchema{
+        "+s", priv->name.c_str(), nullptr, 0,
+        2, priv->child_ptrs, nullptr,
+        &release_schema, priv
+    };
+}
+
+void rrd_export_arrow_array(rrd_span const& span, ArrowArray* array) {
+    auto priv = new array_private;
+    const int64_t length = static_cast<int64_t>(span.size);
+
+    // no validity bitmaps, unknown values are NaN
+    priv->buffers[0] = nullptr;
+    const void* const child_data[2] = { span.timestamps_ns, span.values };
+    for (int i = 0; i < 2; ++i) {
+        auto child_priv = new child_array_private{{nullptr, child_data[i]}};
+        priv->children[i] = ArrowArray{
+            length, 0, 0, 2, 0,
+            child_priv->buffers, nullptr, nullptr,
+            &release_child_array, child_priv
+        };
+        priv->child_ptrs[i] = &priv->children[i];
+    }
+
+    *array = ArrowArray{
+        length, 0, 0, 1, 2,
+        priv->buffers, priv->child_ptrs, nullptr,
+        &release_array, priv
+    };
+}
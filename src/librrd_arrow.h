@@ -0,0 +1,63 @@
+#ifndef LIBRRD_ARROW_H_
+#define LIBRRD_ARROW_H_
+
+/// export of RRAs via the Arrow C data interface,
+/// see https://arrow.apache.org/docs/format/CDataInterface.html
+
+#include <stdint.h>
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    // array type description
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+
+    // release callback
+    void (*release)(struct ArrowSchema*);
+    // opaque producer-specific data
+    void* private_data;
+};
+
+struct ArrowArray {
+    // array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+
+    // release callback
+    void (*release)(struct ArrowArray*);
+    // opaque producer-specific data
+    void* private_data;
+};
+
+#endif // ARROW_C_DATA_INTERFACE
+
+#ifdef __cplusplus
+#include "librrd.h"
+
+/// export schema of RRA entries: struct<time: timestamp[ns, UTC], value: float64>,
+/// unknown values are exported as NaN
+void rrd_export_arrow_schema(rrd_archive const& rra, ArrowSchema* schema);
+
+/// export span of RRA entries (see rrd_archive::spans()) without copying,
+/// the archive must not be modified until the array has been released
+void rrd_export_arrow_array(rrd_span const& span, ArrowArray* array);
+#endif // __cplusplus
+
+#endif // LIBRRD_ARROW_H_
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "librrd_proc.h"
+
+namespace {
+
+/// split off the next line of a text
+std::string_view next_line(std::string_view& text) {
+    std::size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return line;
+}
+
+/// split off the next whitespace separated field of a line
+std::string_view next_field(std::string_view& line) {
+    std::size_t begin = line.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        line = std::string_view();
+        return line;
+    }
+    line.remove_prefix(begin);
+    std::size_t end = line.find_first_of(" \t");
+    std::string_view field = line.substr(0, end);
+    line.remove_prefix(field.size());
+    return field;
+}
+
+/// skip the given number of whitespace separated fields of a line
+void skip_fields(std::string_view& line, int count) {
+    for (int i = 0; i < count; ++i) {
+        (void)next_field(line);
+    }
+}
+
+/// parse an unsigned number, 0 if the field is no number
+std::uint64_t to_number(std::string_view field) {
+    std::uint64_t number = 0;
+    std::from_chars(field.data(), field.data() + field.size(), number);
+    return number;
+}
+
+/// split off the interface name of a line of /proc/net/dev ("  eth0: 123 ...")
+std::string_view netdev_name(std::string_view& line) {
+    std::size_t colon = line.find(':');
+    if (colon == std::string_view::npos) {
+        return std::string_view();
+    }
+    std::string_view name = line.substr(0, colon);
+    line.remove_prefix(colon + 1);
+    return next_field(name);
+}
+
+} // namespace
+
+rrd_proc_file::rrd_proc_file(std::string path, std::size_t buffer_size) :
+    path_(path),
+    fd_(::open(path.c_str(), O_RDONLY | O_CLOEXEC)),
+    buffer_(std::max<std::size_t>(buffer_size, 1)) {
+    if (fd_ < 0) {
+        LOGERR("could not open " << path_ << " for reading");
+    }
+}
+
+rrd_proc_file::~rrd_proc_file() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+rrd_proc_file::rrd_proc_file(rrd_proc_file&& other) noexcept :
+    path_(std::move(other.path_)),
+    fd_(std::exchange(other.fd_, -1)),
+    buffer_(std::move(other.buffer_)) {
+}
+
+std::string_view rrd_proc_file::read() {
+    if (fd_ < 0) {
+        return std::string_view();
+    }
+
+    while (true) {
+        // files within /proc are regenerated when read from the start,
+        // but may be returned in multiple chunks
+        std::size_t size = 0;
+        while (size < buffer_.size()) {
+            ssize_t n = ::pread(fd_, buffer_.data() + size, buffer_.size() - size, size);
+            if (n < 0) {
+                LOGERR("could not read " << path_);
+                return std::string_view();
+            }
+            if (n == 0) {
+                return std::string_view(buffer_.data(), size);
+            }
+            size += n;
+        }
+
+        // buffer too small, grow it and read again from the start
+        buffer_.resize(std::max<std::size_t>(buffer_.size() * 2, 4096));
+        LOG("grew buffer for " << path_ << " to " << buffer_.size());
+    }
+}
+
+rrd_proc_collector::rrd_proc_collector(std::string path) :
+    file_(path) {
+}
+
+std::vector<rrd_data> rrd_proc_collector::create_data(std::list<rrd_archive> const& archives) const {
+    std::vector<rrd_data> data;
+    data.reserve(names_.size());
+    for (std::string const& name : names_) {
+        data.emplace_back(name, archives);
+    }
+    return data;
+}
+
+void rrd_proc_collector::add(std::vector<rrd_data>& data, rrd_data_point::time_point time) const {
+    for (std::size_t i = 0; i < values_.size() && i < data.size(); ++i) {
+        data[i].add(values_[i], time);
+    }
+}
+
+std::size_t rrd_proc_collector::find(std::string_view key, std::size_t expected) const {
+    // keys usually appear in the same order on each sample
+    if (expected < keys_.size() && keys_[expected] == key) {
+        return expected;
+    }
+    for (std::size_t i = 0; i < keys_.size(); ++i) {
+        if (keys_[i] == key) {
+            return i;
+        }
+    }
+    return keys_.size();
+}
+
+void rrd_proc_collector::set_delta(std::size_t index, std::uint64_t counter) {
+    // a decreasing counter has been reset (e.g. device re-plugged) or wrapped, so the difference is unknown
+    values_[index] = (counters_known_[index] && counter >= counters_[index])
+                     ? (rrd_data_point::data_point)(counter - counters_[index])
+                     : rrd_data_point::unknown;
+    counters_[index] = counter;
+    counters_known_[index] = true;
+}
+
+rrd_proc_cpu::rrd_proc_cpu(std::string path) :
+    rrd_proc_collector(path) {
+    // discover CPUs, overall CPU usage is the first line
+    std::string_view text = file_.read();
+    while (!text.empty()) {
+        std::string_view line = next_line(text);
+        std::string_view name = next_field(line);
+        if (name.substr(0, 3) != "cpu") {
+            break;
+        }
+        keys_.emplace_back(name);
+    }
+    names_ = keys_;
+    values_.assign(keys_.size(), rrd_data_point::unknown);
+    // total and work time of each CPU
+    counters_.assign(keys_.size() * 2, 0);
+    counters_known_.assign(keys_.size() * 2, false);
+}
+
+bool rrd_proc_cpu::sample() {
+    std::string_view text = file_.read();
+    values_.assign(values_.size(), rrd_data_point::unknown);
+    if (text.empty()) {
+        return false;
+    }
+
+    std::size_t expected = 0;
+    while (!text.empty()) {
+        std::string_view line = next_line(text);
+        std::string_view name = next_field(line);
+        if (name.substr(0, 3) != "cpu") {
+            break;
+        }
+        std::size_t i = find(name, expected);
+        expected = i + 1;
+        if (i == keys_.size()) {
+            continue;
+        }
+
+        std::uint64_t user    = to_number(next_field(line));
+        std::uint64_t nice    = to_number(next_field(line));
+        std::uint64_t system  = to_number(next_field(line));
+        std::uint64_t idle    = to_number(next_field(line));
+        std::uint64_t iowait  = to_number(next_field(line));
+        std::uint64_t irq     = to_number(next_field(line));
+        std::uint64_t softirq = to_number(next_field(line));
+        std::uint64_t total = user + nice + system + idle + iowait + irq + softirq;
+        std::uint64_t work = total - idle;
+
+        if (counters_known_[2 * i]) {
+            // counters may go down (e.g. iowait of a single core), leading to meaningless usage
+            const std::int64_t total_delta = (std::int64_t)(total - counters_[2 * i]);
+            const std::int64_t work_delta = (std::int64_t)(work - counters_[2 * i + 1]);
+            if (total_delta > 0 && work_delta >= 0 && work_delta <= total_delta) {
+                values_[i] = work_delta / (rrd_data_point::data_point)total_delta * 100.0;
+            }
+        }
+        counters_[2 * i] = total;
+        counters_[2 * i + 1] = work;
+        counters_known_[2 * i] = true;
+    }
+    return true;
+}
+
+rrd_proc_meminfo::rrd_proc_meminfo(std::vector<std::string> keys, std::string path) :
+    rrd_proc_collector(path) {
+    keys_ = keys;
+    names_ = keys;
+    values_.assign(keys_.size(), rrd_data_point::unknown);
+}
+
+bool rrd_proc_meminfo::sample() {
+    std::string_view text = file_.read();
+    values_.assign(values_.size(), rrd_data_point::unknown);
+    if (text.empty()) {
+        return false;
+    }
+
+    std::size_t found = 0;
+    std::size_t expected = 0;
+    while (!text.empty() && found < keys_.size()) {
+        // "MemAvailable:   123456 kB"
+        std::string_view line = next_line(text);
+        std::string_view key = next_field(line);
+        if (key.empty() || key.back() != ':') {
+            continue;
+        }
+        key.remove_suffix(1);
+        std::size_t i = find(key, expected);
+        if (i == keys_.size()) {
+            continue;
+        }
+        expected = i + 1;
+        values_[i] = (rrd_data_point::data_point)to_number(next_field(line));
+        ++found;
+    }
+    return true;
+}
+
+rrd_proc_diskstats::rrd_proc_diskstats(std::string path) :
+    rrd_proc_collector(path) {
+    // discover devices
+    std::string_view text = file_.read();
+    while (!text.empty()) {
+        std::string_view line = next_line(text);
+        skip_fields(line, 2); // major and minor number
+        std::string_view name = next_field(line);
+        if (name.empty()) {
+            continue;
+        }
+        keys_.emplace_back(name);
+        names_.emplace_back(std::string(name) + "_read");
+        names_.emplace_back(std::string(name) + "_written");
+    }
+    values_.assign(names_.size(), rrd_data_point::unknown);
+    counters_.assign(names_.size(), 0);
+    counters_known_.assign(names_.size(), false);
+}
+
+bool rrd_proc_diskstats::sample() {
+    // size of sectors within /proc/diskstats, independent of the device
+    const std::uint64_t sector_size = 512;
+
+    std::string_view text = file_.read();
+    values_.assign(values_.size(), rrd_data_point::unknown);
+    if (text.empty()) {
+        return false;
+    }
+
+    std::size_t expected = 0;
+    while (!text.empty()) {
+        // "   8       0 sda 1234 56 78901 ..."
+        std::string_view line = next_line(text);
+        skip_fields(line, 2); // major and minor number
+        std::size_t i = find(next_field(line), expected);
+        if (i == keys_.size()) {
+            continue;
+        }
+        expected = i + 1;
+
+        skip_fields(line, 2); // reads completed and merged
+        std::uint64_t sectors_read = to_number(next_field(line));
+        skip_fields(line, 3); // time spent reading, writes completed and merged
+        std::uint64_t sectors_written = to_number(next_field(line));
+        set_delta(2 * i, sectors_read * sector_size);
+        set_delta(2 * i + 1, sectors_written * sector_size);
+    }
+    return true;
+}
+
+rrd_proc_netdev::rrd_proc_netdev(std::string path) :
+    rrd_proc_collector(path) {
+    // discover interfaces, skipping both header lines
+    std::string_view text = file_.read();
+    (void)next_line(text);
+    (void)next_line(text);
+    while (!text.empty()) {
+        std::string_view line = next_line(text);
+        std::string_view name = netdev_name(line);
+        if (name.empty()) {
+            continue;
+        }
+        keys_.emplace_back(name);
+        names_.emplace_back(std::string(name) + "_rx");
+        names_.emplace_back(std::string(name) + "_tx");
+    }
+    values_.assign(names_.size(), rrd_data_point::unknown);
+    counters_.assign(names_.size(), 0);
+    counters_known_.assign(names_.size(), false);
+}
+
+bool rrd_proc_netdev::sample() {
+    std::string_view text = file_.read();
+    values_.assign(values_.size(), rrd_data_point::unknown);
+    if (text.empty()) {
+        return false;
+    }
+
+    (void)next_line(text);
+    (void)next_line(text);
+    std::size_t expected = 0;
+    while (!text.empty()) {
+        // "  eth0: 1234 56 0 0 0 0 0 0 7890 12 ..."
+        std::string_view line = next_line(text);
+        std::size_t i = find(netdev_name(line), expected);
+        if (i == keys_.size()) {
+            continue;
+        }
+        expected = i + 1;
+
+        std::uint64_t rx_bytes = to_number(next_field(line));
+        skip_fields(line, 7); // remaining receive statistics
+        std::uint64_t tx_bytes = to_number(next_field(line));
+        set_delta(2 * i, rx_bytes);
+        set_delta(2 * i + 1, tx_bytes);
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+#ifndef LIBRRD_PROC_H_
+#define LIBRRD_PROC_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "librrd.h"
+
+/// file within /proc, kept open and reread from the start into a fixed buffer
+class rrd_proc_file {
+public:
+    /// open file, the buffer only grows if the file content does not fit
+    explicit rrd_proc_file(std::string path, std::size_t buffer_size = 16384);
+    ~rrd_proc_file();
+
+    rrd_proc_file(rrd_proc_file&& other) noexcept;
+    rrd_proc_file(rrd_proc_file const&) = delete;
+    rrd_proc_file& operator=(rrd_proc_file const&) = delete;
+
+    /// reread file content, valid until the next call, empty on error
+    std::string_view read();
+
+    /// return path of the file
+    std::string const& path() const { return path_; }
+    /// return whether the file could be opened
+    bool is_open() const { return fd_ >= 0; }
+
+private:
+    /// path of the file
+    std::string path_;
+    /// file descriptor, -1 if the file could not be opened
+    int fd_;
+    /// buffer holding the file content
+    std::vector<char> buffer_;
+};
+
+/// collector of multiple values from a file within /proc,
+/// samples are parsed without allocations and each value is fed into its own database
+class rrd_proc_collector {
+public:
+    virtual ~rrd_proc_collector() = default;
+
+    /// reread file and update values, values not found are unknown,
+    /// return false if the file could not be read
+    virtual bool sample() = 0;
+
+    /// return names of all series, one per value
+    std::vector<std::string> const& names() const { return names_; }
+    /// return values of the most recent sample
+    std::vector<rrd_data_point::data_point> const& values() const { return values_; }
+
+    /// create one database per series, named after the series
+    std::vector<rrd_data> create_data(std::list<rrd_archive> const& archives) const;
+    /// add values of the most recent sample to the databases created by create_data()
+    void add(std::vector<rrd_data>& data, rrd_data_point::time_point time) const;
+
+protected:
+    explicit rrd_proc_collector(std::string path);
+
+    /// return index of a key, checking the expected index first, keys_.size() if not found
+    std::size_t find(std::string_view key, std::size_t expected) const;
+    /// set value to the difference of a counter since the previous sample,
+    /// unknown for the first sample of the counter and if the counter decreased
+    void set_delta(std::size_t index, std::uint64_t counter);
+
+    /// file to sample
+    rrd_proc_file file_;
+    /// keys (e.g. device names) within the file
+    std::vector<std::string> keys_;
+    /// names of all series
+    std::vector<std::string> names_;
+    /// values of the most recent sample
+    std::vector<rrd_data_point::data_point> values_;
+    /// counters of the previous sample, for collectors reporting differences
+    std::vector<std::uint64_t> counters_;
+    /// whether the counters are known from a previous sample
+    std::vector<bool> counters_known_;
+};
+
+/// CPU usage in percent from /proc/stat, overall ("cpu") and per core ("cpu0", "cpu1", ...),
+/// usage is measured since the previous sample, so the first sample is unknown,
+/// as are samples where the CPU counters decreased
+class rrd_proc_cpu : public rrd_proc_collector {
+public:
+    explicit rrd_proc_cpu(std::string path = "/proc/stat");
+
+    bool sample() override;
+};
+
+/// memory information in kB from /proc/meminfo, e.g. "MemAvailable", "Buffers", "Cached"
+class rrd_proc_meminfo : public rrd_proc_collector {
+public:
+    explicit rrd_proc_meminfo(std::vector<std::string> keys, std::string path = "/proc/meminfo");
+
+    bool sample() override;
+};
+
+/// bytes read ("<device>_read") and written ("<device>_written") since the previous sample
+/// for each block device from /proc/diskstats
+class rrd_proc_diskstats : public rrd_proc_collector {
+public:
+    explicit rrd_proc_diskstats(std::string path = "/proc/diskstats");
+
+    bool sample() override;
+};
+
+/// bytes received ("<interface>_rx") and transmitted ("<interface>_tx") since the previous
+/// sample for each network interface from /proc/net/dev
+class rrd_proc_netdev : public rrd_proc_collector {
+public:
+    explicit rrd_proc_netdev(std::string path = "/proc/net/dev");
+
+    bool sample() override;
+};
+
+#endif // LIBRRD_PROC_H_
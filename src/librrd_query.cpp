@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "librrd_query.h"
+
+namespace {
+
+/// two values
+using value_vec = rrd_data_point::data_point __attribute__((vector_size(16)));
+/// two counts, or the mask of comparing two value vectors
+using index_vec = std::int64_t __attribute__((vector_size(16)));
+
+/// number of values per vector
+constexpr std::size_t vec_lanes = sizeof(value_vec) / sizeof(rrd_data_point::data_point);
+
+/// load vector of consecutive values
+template <class Vec, class T>
+Vec load_vec(T const* data) {
+    Vec v;
+    std::memcpy(&v, data, sizeof(v));
+    return v;
+}
+
+value_vec load(rrd_data_point::data_point const* data) { return load_vec<value_vec>(data); }
+index_vec load(std::int64_t const* data) { return load_vec<index_vec>(data); }
+
+/// store vector to consecutive values
+template <class Vec, class T>
+void store(T* data, Vec v) {
+    std::memcpy(data, &v, sizeof(v));
+}
+
+} // namespace
+
+rrd_query::rrd_query(std::string archive, rrd_data_point::clock::duration resolution, int af) :
+    archive_(archive),
+    resolution_(resolution),
+    af_(af) {
+    assert(resolution_.count() > 0 && "resolution must be positive");
+}
+
+rrd_query::accumulator::accumulator(std::size_t buckets) :
+    sum(buckets, 0.0),
+    min(buckets, std::numeric_limits<rrd_data_point::data_point>::infinity()),
+    max(buckets, -std::numeric_limits<rrd_data_point::data_point>::infinity()),
+    count(buckets, 0) {
+}
+
+void rrd_query::accumulator::add(rrd_span const& span, std::int64_t begin, std::int64_t end,
+                                 std::int64_t resolution) {
+    // RRA entries are ordered by time, so the entries within [begin, end)
+    // form a contiguous block of the span
+    std::int64_t const* first = std::lower_bound(span.timestamps_ns, span.timestamps_ns + span.size, begin);
+    std::int64_t const* last = std::lower_bound(first, span.timestamps_ns + span.size, end);
+    std::size_t offset = first - span.timestamps_ns;
+    std::size_t size = last - first;
+
+    std::int64_t const* times = first;
+    rrd_data_point::data_point const* values = span.values + offset;
+    std::size_t i = 0;
+    while (i < size) {
+        // run of consecutive entries falling into consecutive buckets, one entry per bucket,
+        // which is the usual case if the resolution equals the time span of RRA entries,
+        // several entries within the same bucket result in runs of a single entry
+        const std::size_t b = (times[i] - begin) / resolution;
+        std::int64_t bucket_begin = begin + (std::int64_t)b * resolution;
+        std::size_t run_end = i;
+        while (run_end < size && times[run_end] >= bucket_begin && times[run_end] < bucket_begin + resolution) {
+            ++run_end;
+            bucket_begin += resolution;
+        }
+
+        add_run(values + i, b, run_end - i);
+        i = run_end;
+    }
+}
+
+void rrd_query::accumulator::add_run(rrd_data_point::data_point const* values, std::size_t bucket,
+                                     std::size_t size) {
+    // entry j is added to bucket + j, so buckets and entries are processed element-wise
+    // in explicit SIMD vectors (GCC vector extensions, SSE2 on x86-64),
+    // unknown (NaN) entries are masked out without branching, see rrd_archive::avg()
+    rrd_data_point::data_point* sums = sum.data() + bucket;
+    rrd_data_point::data_point* mins = min.data() + bucket;
+    rrd_data_point::data_point* maxs = max.data() + bucket;
+    std::int64_t* counts = count.data() + bucket;
+    const value_vec zero = {0.0, 0.0};
+    std::size_t j = 0;
+    for (; j + vec_lanes <= size; j += vec_lanes) {
+        const value_vec v = load(values + j);
+        const index_vec known = (v == v);
+        store(sums + j, load(sums + j) + (known ? v : zero));
+        // mask of known entries is -1 per lane
+        store(counts + j, load(counts + j) - known);
+        const value_vec m = load(mins + j);
+        store(mins + j, (v < m) ? v : m);
+        const value_vec n = load(maxs + j);
+        store(maxs + j, (v > n) ? v : n);
+    }
+    for (; j < size; ++j) {
+        const rrd_data_point::data_point v = values[j];
+        const bool known = (v == v);
+        sums[j] += known ? v : 0.0;
+        counts[j] += known;
+        mins[j] = (v < mins[j]) ? v : mins[j];
+        maxs[j] = (v > maxs[j]) ? v : maxs[j];
+    }
+}
+
+void rrd_query::accumulator::merge(accumulator const& other) {
+    for (std::size_t b = 0; b < sum.size(); ++b) {
+        sum[b] += other.sum[b];
+        count[b] += other.count[b];
+        min[b] = (other.min[b] < min[b]) ? other.min[b] : min[b];
+        max[b] = (other.max[b] > max[b]) ? other.max[b] : max[b];
+    }
+}
+
+std::vector<rrd_data_point> rrd_query::run(std::vector<rrd_data const*> const& series,
+                                           rrd_data_point::time_point begin,
+                                           rrd_data_point::time_point end,
+                                           unsigned int threads) const {
+    std::vector<rrd_data_point> result;
+    if (end <= begin) {
+        return result;
+    }
+
+    const std::int64_t begin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(begin.time_since_epoch()).count();
+    const std::int64_t end_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end.time_since_epoch()).count();
+    const std::int64_t resolution_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(resolution_).count();
+    const std::size_t buckets = (end_ns - begin_ns + resolution_ns - 1) / resolution_ns;
+    if (buckets > max_buckets) {
+        LOGERR("query of " << archive_ << " with " << buckets << " buckets exceeds maximum of " << max_buckets);
+        return result;
+    }
+
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    // split series into one chunk per thread, limited by the memory of the partial aggregates
+    const std::size_t chunks = std::max<std::size_t>(
+        std::min<std::size_t>({threads, series.size(), max_buckets / buckets}), 1);
+    std::vector<accumulator> partials(chunks, accumulator(buckets));
+
+    auto process_chunk = [&](std::size_t chunk) {
+        const std::size_t first = chunk * series.size() / chunks;
+        const std::size_t last = (chunk + 1) * series.size() / chunks;
+        for (std::size_t s = first; s < last; ++s) {
+            auto const& archives = series[s]->archives();
+            auto rra = std::find_if(archives.begin(), archives.end(), [this](rrd_archive const& a) {
+                return a.name() == archive_;
+            });
+            if (rra == archives.end()) {
+                LOGERR("series " << series[s]->name() << " has no archive " << archive_);
+                continue;
+            }
+
+            // the ring buffer of each series may wrap at a different position
+            auto spans = rra->spans();
+            partials[chunk].add(spans.first, begin_ns, end_ns, resolution_ns);
+            partials[chunk].add(spans.second, begin_ns, end_ns, resolution_ns);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+        workers.emplace_back(process_chunk, chunk);
+    }
+    process_chunk(0);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    // combine partial aggregates pairwise, level by level, until the first one holds the total
+    for (std::size_t step = 1; step < chunks; step *= 2) {
+        for (std::size_t chunk = 0; chunk + step < chunks; chunk += 2 * step) {
+            partials[chunk].merge(partials[chunk + step]);
+        }
+    }
+    accumulator const& total = partials.front();
+
+    result.reserve(buckets);
+    for (std::size_t b = 0; b < buckets; ++b) {
+        const rrd_data_point::time_point time = begin + b * resolution_;
+        if (total.count[b] == 0 && af_ != COUNT) {
+            result.emplace_back(rrd_data_point::unknown, time);
+            continue;
+        }
+
+        switch (af_) {
+        case SUM:
+            result.emplace_back(total.sum[b], time);
+            break;
+        case AVG:
+            result.emplace_back(total.sum[b] / total.count[b], time);
+            break;
+        case MIN:
+            result.emplace_back(total.min[b], time);
+            break;
+        case MAX:
+            result.emplace_back(total.max[b], time);
+            break;
+        case COUNT:
+            result.emplace_back(total.count[b], time);
+            break;
+        default:
+            assert(false && "unknown aggregate function");
+            result.emplace_back(rrd_data_point::unknown, time);
+            break;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,79 @@
+#ifndef LIBRRD_QUERY_H_
+#define LIBRRD_QUERY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "librrd.h"
+
+/// aggregation of one RRA across many databases (series),
+/// e.g. the sum of the CPU usage of all hosts per 5 minutes
+class rrd_query {
+public:
+    /// aggregate function for combining RRA entries of all series within a time bucket
+    enum aggregate_function {
+        SUM,
+        AVG,
+        MIN,
+        MAX,
+        /// number of known RRA entries
+        COUNT
+    };
+
+    /// maximum number of buckets of all partial aggregates of a query,
+    /// each bucket takes 32 bytes per chunk of series
+    static constexpr std::size_t max_buckets = std::size_t(1) << 22;
+
+    /// query RRA with the given name of each series,
+    /// aggregating all entries within buckets of the given resolution
+    rrd_query(std::string archive, rrd_data_point::clock::duration resolution, int af);
+
+    /// aggregate all known RRA entries within [begin, end) of all series,
+    /// returns one data point per bucket with the time of the start of the bucket,
+    /// unknown if no series has a known RRA entry within the bucket,
+    /// work is split into chunks of series processed by up to the given number of threads
+    /// (0: hardware concurrency),
+    /// each chunk allocates 32 bytes per bucket for its partial aggregates, so the number of
+    /// chunks is reduced to stay within max_buckets in total, and queries with more than
+    /// max_buckets buckets are rejected (empty result)
+    std::vector<rrd_data_point> run(std::vector<rrd_data const*> const& series,
+                                    rrd_data_point::time_point begin,
+                                    rrd_data_point::time_point end,
+                                    unsigned int threads = 0) const;
+
+    /// return name of the queried RRA
+    std::string const& archive() const { return archive_; }
+    /// return time span of each bucket
+    rrd_data_point::clock::duration resolution() const { return resolution_; }
+    /// return aggregate function
+    int af() const { return af_; }
+
+private:
+    /// partial aggregates of a chunk of series, one element per bucket
+    struct accumulator {
+        explicit accumulator(std::size_t buckets);
+
+        /// add all RRA entries of a span within [begin, end)
+        void add(rrd_span const& span, std::int64_t begin, std::int64_t end, std::int64_t resolution);
+        /// add entries falling into consecutive buckets, one entry per bucket
+        void add_run(rrd_data_point::data_point const* values, std::size_t bucket, std::size_t size);
+        /// combine with partial aggregates of another chunk
+        void merge(accumulator const& other);
+
+        std::vector<rrd_data_point::data_point> sum;
+        std::vector<rrd_data_point::data_point> min;
+        std::vector<rrd_data_point::data_point> max;
+        std::vector<std::int64_t> count;
+    };
+
+    /// name of the queried RRA
+    std::string archive_;
+    /// time span of each bucket
+    rrd_data_point::clock::duration resolution_;
+    /// aggregate function
+    int af_;
+};
+
+#endif // LIBRRD_QUERY_H_
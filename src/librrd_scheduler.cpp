@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <utility>
+
+#include "librrd_scheduler.h"
+
+void rrd_scheduler::task::promise_type::unhandled_exception() {
+    LOGERR("unhandled exception in scheduled coroutine");
+    std::terminate();
+}
+
+rrd_scheduler::periodic::periodic(rrd_scheduler& scheduler, clock::duration interval,
+                                  clock::duration offset) :
+    scheduler_(scheduler),
+    interval_(interval),
+    deadline_(clock::now() + offset),
+    started_(false),
+    skipped_(0) {
+    assert(interval_.count() > 0 && "interval must be positive");
+}
+
+void rrd_scheduler::periodic::suspend(std::coroutine_handle<> handle) {
+    if (started_) {
+        deadline_ += interval_;
+    }
+    started_ = true;
+
+    // skip deadlines missed by more than a whole interval instead of catching up in a burst,
+    // deadlines stay multiples of the interval so there is no drift
+    const clock::time_point now = clock::now();
+    if (deadline_ + interval_ <= now) {
+        const auto missed = (now - deadline_) / interval_;
+        LOG("periodic timer missed " << missed << " deadlines");
+        deadline_ += missed * interval_;
+        skipped_ += missed;
+    }
+
+    scheduler_.schedule(handle, deadline_);
+}
+
+rrd_scheduler::rrd_scheduler(clock::duration granularity, std::size_t slots) :
+    granularity_(granularity),
+    wheel_(slots),
+    wheel_pos_(0),
+    wheel_time_(clock::now()),
+    timers_(0),
+    steady_start_(wheel_time_),
+    system_start_(rrd_data_point::clock::now()),
+    stop_(false) {
+    assert(granularity_.count() > 0 && "granularity must be positive");
+    assert(slots > 0 && "timer wheel needs at least one slot");
+}
+
+rrd_scheduler::~rrd_scheduler() {
+    for (void* address : tasks_) {
+        std::coroutine_handle<>::from_address(address).destroy();
+    }
+}
+
+void rrd_scheduler::spawn(task t) {
+    std::coroutine_handle<> handle = std::exchange(t.handle_, nullptr);
+    tasks_.insert(handle.address());
+    ready_.push_back(handle);
+}
+
+void rrd_scheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wait_mutex_);
+        stop_ = true;
+    }
+    wait_cond_.notify_all();
+}
+
+rrd_data_point::time_point rrd_scheduler::to_time(clock::time_point t) const {
+    return system_start_ + std::chrono::duration_cast<rrd_data_point::clock::duration>(t - steady_start_);
+}
+
+void rrd_scheduler::schedule(std::coroutine_handle<> handle, clock::time_point deadline) {
+    // deadline within an already expired slot
+    if (deadline < wheel_time_) {
+        ready_.push_back(handle);
+        return;
+    }
+
+    const std::size_t ticks = (deadline - wheel_time_) / granularity_;
+    wheel_[(wheel_pos_ + ticks) % wheel_.size()].push_back(timer{deadline, handle});
+    ++timers_;
+}
+
+void rrd_scheduler::resume(std::coroutine_handle<> handle) {
+    handle.resume();
+    if (handle.done()) {
+        tasks_.erase(handle.address());
+        handle.destroy();
+    }
+}
+
+void rrd_scheduler::expire(clock::time_point now) {
+    // expire all slots whose time span has passed completely
+    while (wheel_time_ + granularity_ <= now) {
+        expire_timers(wheel_[wheel_pos_], wheel_time_ + granularity_);
+        wheel_pos_ = (wheel_pos_ + 1 == wheel_.size()) ? 0 : wheel_pos_ + 1;
+        wheel_time_ += granularity_;
+    }
+    // expire timers of the current slot which are already due
+    expire_timers(wheel_[wheel_pos_], now + clock::duration(1));
+}
+
+void rrd_scheduler::expire_timers(std::vector<timer>& slot, clock::time_point until) {
+    // timers for later rotations of the wheel (or later within the slot) stay within the slot
+    auto expired = std::partition(slot.begin(), slot.end(), [until](timer const& t) {
+        return t.deadline >= until;
+    });
+    std::sort(expired, slot.end(), [](timer const& t1, timer const& t2) {
+        return t1.deadline < t2.deadline;
+    });
+    for (auto it = expired; it != slot.end(); ++it) {
+        ready_.push_back(it->handle);
+    }
+    timers_ -= slot.end() - expired;
+    slot.erase(expired, slot.end());
+}
+
+rrd_scheduler::clock::time_point rrd_scheduler::next_expiry() const {
+    for (std::size_t i = 0; i < wheel_.size(); ++i) {
+        // earliest timer of the slot expiring within the current rotation of the wheel
+        const clock::time_point slot_end = wheel_time_ + (i + 1) * granularity_;
+        clock::time_point earliest = clock::time_point::max();
+        for (timer const& t : wheel_[(wheel_pos_ + i) % wheel_.size()]) {
+            if (t.deadline < slot_end) {
+                earliest = std::min(earliest, t.deadline);
+            }
+        }
+        if (earliest != clock::time_point::max()) {
+            return earliest;
+        }
+    }
+    return wheel_time_ + wheel_.size() * granularity_;
+}
+
+void rrd_scheduler::run_until(clock::time_point limit) {
+    while (!stop_ && !tasks_.empty()) {
+        // resume all coroutines that are due
+        while (!ready_.empty() && !stop_) {
+            std::coroutine_handle<> handle = ready_.front();
+            ready_.pop_front();
+            resume(handle);
+        }
+        if (stop_ || tasks_.empty()) {
+            break;
+        }
+        if (timers_ == 0) {
+            LOGERR("coroutines left but none of them waits for a timer");
+            break;
+        }
+
+        // expire all timers up to now, sleep until the next one if nothing is due,
+        // deadlines are absolute so oversleeping does not accumulate
+        const clock::time_point now = clock::now();
+        if (now >= limit) {
+            break;
+        }
+        expire(now);
+        if (ready_.empty()) {
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            wait_cond_.wait_until(lock, std::min(next_expiry(), limit), [this]() {
+                return stop_.load();
+            });
+        }
+    }
+
+    // the stop request has been honored, reset it at the end instead of the beginning
+    // so a stop() arriving before (or just as) the run starts is not lost
+    stop_ = false;
+}
+
+rrd_scheduler::task rrd_collect(rrd_scheduler& scheduler, rrd_data& data,
+                                rrd_scheduler::clock::duration interval,
+                                std::function<rrd_data_point::data_point()> sample) {
+    rrd_scheduler::periodic timer(scheduler, interval);
+    while (true) {
+        const rrd_data_point::time_point time = co_await timer.next();
+        data.add(sample(), time);
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef LIBRRD_SCHEDULER_H_
+#define LIBRRD_SCHEDULER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "librrd.h"
+
+/// single threaded event loop resuming coroutines at given points in time,
+/// allows many periodic collectors to share one thread instead of sleeping in one thread each
+class rrd_scheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /// coroutine owned and resumed by the scheduler, see spawn()
+    class task {
+    public:
+        struct promise_type {
+            task get_return_object() { return task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception();
+        };
+
+        task(task&& other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+        task(task const&) = delete;
+        task& operator=(task const&) = delete;
+        ~task() { if (handle_) handle_.destroy(); }
+
+    private:
+        friend class rrd_scheduler;
+        explicit task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    /// awaitable suspending the awaiting coroutine until a deadline
+    class sleep_awaitable {
+    public:
+        sleep_awaitable(rrd_scheduler& scheduler, clock::time_point deadline) :
+            scheduler_(scheduler), deadline_(deadline) {}
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { scheduler_.schedule(handle, deadline_); }
+        void await_resume() const noexcept {}
+
+    private:
+        rrd_scheduler& scheduler_;
+        clock::time_point deadline_;
+    };
+
+    /// drift-free periodic timer, deadlines are multiples of the interval
+    /// after the start, independent of how late the awaiting coroutine gets resumed
+    class periodic {
+    public:
+        /// first deadline will be start + offset
+        periodic(rrd_scheduler& scheduler, clock::duration interval,
+                 clock::duration offset = clock::duration::zero());
+
+        /// awaitable suspending until the next deadline, returns its (wall clock) time,
+        /// deadlines already missed completely are skipped
+        auto next() {
+            struct awaitable {
+                periodic& timer;
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> handle) { timer.suspend(handle); }
+                rrd_data_point::time_point await_resume() const { return timer.scheduler_.to_time(timer.deadline_); }
+            };
+            return awaitable{*this};
+        }
+
+        /// return current (or most recent) deadline
+        clock::time_point deadline() const { return deadline_; }
+        /// return number of skipped deadlines
+        unsigned long long skipped() const { return skipped_; }
+
+    private:
+        /// advance deadline and schedule coroutine
+        void suspend(std::coroutine_handle<> handle);
+
+        rrd_scheduler& scheduler_;
+        clock::duration interval_;
+        clock::time_point deadline_;
+        bool started_;
+        unsigned long long skipped_;
+    };
+
+    /// create scheduler, timers are kept in a timer wheel
+    /// with the given number of slots of the given granularity
+    explicit rrd_scheduler(clock::duration granularity = std::chrono::milliseconds(1),
+                           std::size_t slots = 4096);
+    ~rrd_scheduler();
+
+    rrd_scheduler(rrd_scheduler const&) = delete;
+    rrd_scheduler& operator=(rrd_scheduler const&) = delete;
+
+    /// take ownership of a coroutine and resume it on the next run
+    void spawn(task t);
+    /// awaitable suspending the awaiting coroutine until the given deadline
+    sleep_awaitable sleep_until(clock::time_point deadline) { return sleep_awaitable(*this, deadline); }
+    /// awaitable suspending the awaiting coroutine for the given duration
+    sleep_awaitable sleep_for(clock::duration duration) { return sleep_awaitable(*this, clock::now() + duration); }
+
+    /// run until all coroutines are done or stop() gets called
+    void run() { run_until(clock::time_point::max()); }
+    /// run until all coroutines are done, stop() gets called or the given time is reached
+    void run_until(clock::time_point limit);
+    /// make run() return as soon as possible, may be called from any thread,
+    /// if no run is in progress, the next run returns immediately,
+    /// wakes up the scheduler if it is waiting for the next timer
+    /// (but does not interrupt a running coroutine)
+    void stop();
+
+    /// return number of coroutines not done yet
+    std::size_t tasks() const { return tasks_.size(); }
+    /// return wall clock time corresponding to a steady clock time point of the scheduler
+    rrd_data_point::time_point to_time(clock::time_point t) const;
+
+private:
+    /// coroutine waiting for a deadline
+    struct timer {
+        clock::time_point deadline;
+        std::coroutine_handle<> handle;
+    };
+
+    /// resume coroutine at the given deadline
+    void schedule(std::coroutine_handle<> handle, clock::time_point deadline);
+    /// resume coroutine and destroy it if done
+    void resume(std::coroutine_handle<> handle);
+    /// move all timers due until now to the ready queue and advance the wheel
+    void expire(clock::time_point now);
+    /// move timers of a slot expiring before the given time to the ready queue
+    void expire_timers(std::vector<timer>& slot, clock::time_point until);
+    /// return deadline of the next timer, or the end of the wheel rotation if there is none
+    clock::time_point next_expiry() const;
+
+    /// time span of each slot
+    clock::duration granularity_;
+    /// timer wheel, each slot holds timers expiring within its time span (modulo the rotation)
+    std::vector<std::vector<timer>> wheel_;
+    /// position of the next slot to expire
+    std::size_t wheel_pos_;
+    /// start of the time span of the next slot to expire
+    clock::time_point wheel_time_;
+    /// number of timers within the wheel
+    std::size_t timers_;
+    /// coroutines to resume immediately
+    std::deque<std::coroutine_handle<>> ready_;
+    /// all coroutines not done yet
+    std::unordered_set<void*> tasks_;
+    /// steady clock time of creation, for converting deadlines to wall clock time
+    clock::time_point steady_start_;
+    /// wall clock time of creation, for converting deadlines to wall clock time
+    rrd_data_point::time_point system_start_;
+    /// set by stop()
+    std::atomic<bool> stop_;
+    /// protects waiting for the next timer against a concurrent stop()
+    std::mutex wait_mutex_;
+    /// signaled by stop() to end waiting for the next timer
+    std::condition_variable wait_cond_;
+};
+
+/// coroutine adding a sample to a database every interval until the scheduler stops,
+/// using the (drift-free) deadline of each interval as time of the PDP
+rrd_scheduler::task rrd_collect(rrd_scheduler& scheduler, rrd_data& data,
+                                rrd_scheduler::clock::duration interval,
+                                std::function<rrd_data_point::data_point()> sample);
+
+#endif // LIBRRD_SCHEDULER_H_
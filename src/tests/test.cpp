@@ -1,14 +1,25 @@
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <list>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 #define private public
 #include "librrd.h"
+#include "librrd_arrow.h"
+#include "librrd_proc.h"
+#include "librrd_query.h"
+#include "librrd_scheduler.h"
+
+extern "C" void check_arrow_export(ArrowSchema* schema, ArrowArray* array,
+                                   const char* name, const double* values, const int64_t* times, int64_t n);
 
 /// print content of all RRAs
 void print(rrd_data const& data) {
@@ -264,11 +275,601 @@ void test_04() {
                               rrd_archive::TIME_SINCE_EPOCH, rrd_archive::VAL_SCIENTIFIC);
 }
 
+/// test unknown PDPs and the x-files factor
+void test_05() {
+    const int steps = 4;
+    const int rra_size = 3;
+    rrd_data data("test_05", std::list<rrd_archive>{
+        // archive containing every data point with a maximum size of 12
+        rrd_archive("all", 1, steps * rra_size, rrd_archive::AVG),
+        // archives allowing half of the PDPs to be unknown
+        rrd_archive("min", steps, rra_size, rrd_archive::MIN, 0.5),
+        rrd_archive("max", steps, rra_size, rrd_archive::MAX, 0.5),
+        rrd_archive("avg", steps, rra_size, rrd_archive::AVG, 0.5),
+        // archive not allowing any unknown PDP
+        rrd_archive("strict", steps, rra_size, rrd_archive::AVG, 0.0)
+    });
+
+    // first RRA entry: one unknown PDP,
+    // second RRA entry: two unknown PDPs (exactly the xff),
+    // third RRA entry: three unknown PDPs (exceeding the xff)
+    const rrd_data_point::data_point u = rrd_data_point::unknown;
+    const std::vector<rrd_data_point::data_point> values{
+        1.0, u, 3.0, 2.0,
+        u, 5.0, u, 7.0,
+        u, u, 9.0, u
+    };
+    const rrd_data_point::time_point t;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        data.add(values[i], t + rrd_archive::dump_resolution(i));
+        if (i == 4) {
+            // pending unknown PDP is tracked until consolidation
+            for (auto const& a : data.archives()) {
+                assert(a.unknowns() == (a.steps() == 1 ? 0 : 1));
+            }
+        }
+    }
+    print(data);
+
+    std::list<rrd_archive>::const_iterator it = data.archives().begin();
+    assert_equal_dump_content("0 1\n1 nan\n2 3\n3 2\n4 nan\n5 5\n6 nan\n7 7\n8 nan\n9 nan\n10 9\n11 nan\n", *it);
+
+    // check RRA min
+    ++it;
+    assert(it->unknowns() == 0);
+    assert(!it->archive()[0].is_unknown() && almost_equal(it->archive()[0].value(), 1.0));
+    assert(!it->archive()[1].is_unknown() && almost_equal(it->archive()[1].value(), 5.0));
+    assert(it->archive()[2].is_unknown());
+    assert_equal_dump_content("0 1\n5 5\n11 nan\n", *it);
+
+    // check RRA max
+    ++it;
+    assert_equal_dump_content("2 3\n7 7\n11 nan\n", *it);
+
+    // check RRA avg
+    ++it;
+    assert_equal_dump_content("3 2\n7 6\n11 nan\n", *it);
+    assert_equal_dump_content("3 2.000000\n7 6.000000\n11 nan\n", *it,
+                              rrd_archive::TIME_SINCE_EPOCH, rrd_archive::VAL_FIXED);
+
+    // check RRA strict
+    ++it;
+    assert(it->xff() == 0.0);
+    assert_equal_dump_content("3 nan\n7 nan\n11 nan\n", *it);
+}
+
+/// test zero-copy export of RRA entries as spans and via the Arrow C data interface
+void test_06() {
+    const int pdps = 7;
+    const int rra_size = 5;
+    rrd_data data("test_06", std::list<rrd_archive>{
+        // archive containing every data point with a maximum size of 5
+        rrd_archive("all", 1, rra_size, rrd_archive::AVG)
+    });
+    rrd_archive const& all = data.archives().front();
+
+    // empty archive
+    auto spans = all.spans();
+    assert(spans.first.size == 0 && spans.second.size == 0);
+
+    // populate with more PDPs than rows, the ring buffer will wrap after 5 entries
+    const rrd_data_point::time_point t;
+    std::vector<rrd_data_point::data_point> values;
+    std::vector<std::int64_t> times;
+    for (int i = 0; i < pdps; ++i) {
+        rrd_data_point::data_point v = (i == 5) ? rrd_data_point::unknown : i * 1.5;
+        data.add(v, t + rrd_archive::dump_resolution(i));
+        values.push_back(v);
+        times.push_back(i * 1000000);
+    }
+    print(data);
+    assert_equal_dump_content("2 3\n3 4.5\n4 6\n5 nan\n6 9\n", all);
+
+    // spans hold the oldest entries up to the end of the ring buffer, followed by the wrapped ones
+    spans = all.spans();
+    assert(spans.first.size == 3 && spans.second.size == 2);
+    assert(spans.first.values == all.archive_values_.data() + 2);
+    assert(spans.second.values == all.archive_values_.data());
+    std::size_t i = 0;
+    for (rrd_span const& span : {spans.first, spans.second}) {
+        for (std::size_t j = 0; j < span.size; ++j, ++i) {
+            assert(span.timestamps_ns[j] == times[i + 2]);
+            assert(all.archive()[i].is_unknown() == std::isnan(span.values[j]));
+        }
+    }
+
+    // export both spans via the Arrow C data interface, one array per span
+    ArrowSchema schema;
+    ArrowArray array;
+    rrd_export_arrow_schema(all, &schema);
+    rrd_export_arrow_array(spans.first, &array);
+    assert(array.children[1]->buffers[1] == spans.first.values);
+    check_arrow_export(&schema, &array, "all", values.data() + 2, times.data() + 2, 3);
+
+    rrd_export_arrow_schema(all, &schema);
+    rrd_export_arrow_array(spans.second, &array);
+    assert(array.children[0]->buffers[1] == spans.second.timestamps_ns);
+    check_arrow_export(&schema, &array, "all", values.data() + 5, times.data() + 5, 2);
+}
+
+/// compare query result against expected values, element by element
+void assert_equal_result(std::vector<rrd_data_point::data_point> const& expected,
+                         std::vector<rrd_data_point> const& actual) {
+    assert(expected.size() == actual.size());
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        if (std::isnan(expected[i])) {
+            assert(actual[i].is_unknown());
+        } else {
+            if (!almost_equal(expected[i], actual[i].value())) {
+                LOG("bucket " << i << ": " << expected[i] << " =? " << actual[i].value());
+            }
+            assert(almost_equal(expected[i], actual[i].value()));
+        }
+    }
+}
+
+/// test aggregation across multiple series with differently wrapped ring buffers
+void test_07() {
+    const int rra_size = 4;
+    std::list<rrd_archive> archives{
+        // archive containing every data point with a maximum size of 4
+        rrd_archive("all", 1, rra_size, rrd_archive::AVG),
+        // archive containing the average of every 2 data points with a maximum size of 4
+        rrd_archive("avg", 2, rra_size, rrd_archive::AVG)
+    };
+    rrd_data a("test_07_a", archives);
+    rrd_data b("test_07_b", archives);
+    rrd_data c("test_07_c", archives);
+    rrd_data d("test_07_d", std::list<rrd_archive>{
+        // archive not being queried at all
+        rrd_archive("other", 1, rra_size, rrd_archive::AVG)
+    });
+
+    // a: wrapped twice, holds 3, 4, 5, 6 at 2 s .. 5 s
+    const rrd_data_point::time_point t;
+    for (int i = 0; i < 6; ++i) {
+        a.add(i + 1, t + std::chrono::seconds(i));
+    }
+    // b: not wrapped, holds 10, 20, 30 at 2.5 s .. 4.5 s
+    for (int i = 0; i < 3; ++i) {
+        b.add((i + 1) * 10, t + std::chrono::milliseconds(2500 + i * 1000));
+    }
+    // c: wrapped once, holds unknown, 100, 100, 100 at 2 s .. 5 s
+    for (int i = 0; i < 5; ++i) {
+        c.add(i == 1 ? rrd_data_point::unknown : 100, t + std::chrono::seconds(i + 1));
+    }
+    d.add(1000, t + std::chrono::seconds(3));
+    print(a);
+    print(b);
+    print(c);
+    assert(a.archives().front().head_ == 2);
+    assert(b.archives().front().head_ == 0);
+    assert(c.archives().front().head_ == 1);
+
+    const std::vector<rrd_data const*> series{&a, &b, &c, &d};
+    const rrd_data_point::data_point u = rrd_data_point::unknown;
+    for (unsigned int threads : {1, 2, 3, 4, 8}) {
+        rrd_query sum("all", std::chrono::seconds(1), rrd_query::SUM);
+        auto result = sum.run(series, t + std::chrono::seconds(2), t + std::chrono::seconds(7), threads);
+        assert_equal_result(std::vector<rrd_data_point::data_point>{
+            13, 124, 135, 106, u
+            }, result);
+        assert(result[1].time() == t + std::chrono::seconds(3));
+
+        assert_equal_result(std::vector<rrd_data_point::data_point>{
+            6.5, 41.33, 45, 53, u
+            }, rrd_query("all", std::chrono::seconds(1), rrd_query::AVG).run(
+                series, t + std::chrono::seconds(2), t + std::chrono::seconds(7), threads));
+        assert_equal_result(std::vector<rrd_data_point::data_point>{
+            3, 4, 5, 6, u
+            }, rrd_query("all", std::chrono::seconds(1), rrd_query::MIN).run(
+                series, t + std::chrono::seconds(2), t + std::chrono::seconds(7), threads));
+        assert_equal_result(std::vector<rrd_data_point::data_point>{
+            10, 100, 100, 100, u
+            }, rrd_query("all", std::chrono::seconds(1), rrd_query::MAX).run(
+                series, t + std::chrono::seconds(2), t + std::chrono::seconds(7), threads));
+        assert_equal_result(std::vector<rrd_data_point::data_point>{
+            2, 3, 3, 2, 0
+            }, rrd_query("all", std::chrono::seconds(1), rrd_query::COUNT).run(
+                series, t + std::chrono::seconds(2), t + std::chrono::seconds(7), threads));
+
+        // coarser buckets, the last one only partially covered by the query range
+        assert_equal_result(std::vector<rrd_data_point::data_point>{
+            137, 135
+            }, rrd_query("all", std::chrono::seconds(2), rrd_query::SUM).run(
+                series, t + std::chrono::seconds(2), t + std::chrono::seconds(5), threads));
+    }
+
+    // long runs of entries in consecutive buckets, interrupted by a gap and an unknown entry
+    rrd_data e("test_07_e", std::list<rrd_archive>{
+        rrd_archive("all", 1, 20, rrd_archive::AVG)
+    });
+    for (int i = 0; i < 11; ++i) {
+        if (i != 6) {
+            e.add(i == 3 ? rrd_data_point::unknown : i, t + std::chrono::seconds(i));
+        }
+    }
+    const std::vector<rrd_data const*> single{&e};
+    assert_equal_result(std::vector<rrd_data_point::data_point>{
+        0, 1, 2, u, 4, 5, u, 7, 8, 9, 10, u
+        }, rrd_query("all", std::chrono::seconds(1), rrd_query::MAX).run(
+            single, t, t + std::chrono::seconds(12)));
+    assert_equal_result(std::vector<rrd_data_point::data_point>{
+        1, 0, 1, 1, 0, 1, 1, 1, 1, 0
+        }, rrd_query("all", std::chrono::seconds(1), rrd_query::COUNT).run(
+            single, t + std::chrono::seconds(2), t + std::chrono::seconds(12)));
+    assert_equal_result(std::vector<rrd_data_point::data_point>{
+        1, 2, 9, 7, 17, 10
+        }, rrd_query("all", std::chrono::seconds(2), rrd_query::SUM).run(
+            std::vector<rrd_data const*>{&e, &d}, t, t + std::chrono::seconds(12)));
+
+    // too many buckets
+    assert(rrd_query("all", std::chrono::milliseconds(1), rrd_query::SUM).run(
+               series, t, t + std::chrono::hours(24 * 30)).empty());
+
+    // empty query range
+    assert(rrd_query("all", std::chrono::seconds(1), rrd_query::SUM).run(
+               series, t + std::chrono::seconds(2), t + std::chrono::seconds(2)).empty());
+}
+
+/// collector for test_08, sampling its index and tracking how late it gets resumed
+rrd_scheduler::task test_08_collector(rrd_scheduler& scheduler, rrd_data& data,
+                                      rrd_scheduler::clock::duration interval,
+                                      rrd_scheduler::clock::duration offset,
+                                      rrd_scheduler::clock::duration& max_lateness,
+                                      unsigned long long& max_skipped) {
+    rrd_scheduler::periodic timer(scheduler, interval, offset);
+    while (true) {
+        const rrd_data_point::time_point time = co_await timer.next();
+        max_lateness = std::max(max_lateness, rrd_scheduler::clock::now() - timer.deadline());
+        max_skipped = std::max(max_skipped, timer.skipped());
+        data.add(1.0, time);
+    }
+}
+
+/// finite coroutine for test_08
+rrd_scheduler::task test_08_sleeper(rrd_scheduler& scheduler, int& wakeups) {
+    for (int i = 0; i < 3; ++i) {
+        co_await scheduler.sleep_for(std::chrono::milliseconds(10));
+        ++wakeups;
+    }
+}
+
+/// coroutine waiting much longer than test_08 runs
+rrd_scheduler::task test_08_distant_sleeper(rrd_scheduler& scheduler, int& wakeups) {
+    co_await scheduler.sleep_for(std::chrono::seconds(60));
+    ++wakeups;
+}
+
+/// test many periodic collectors on a single thread
+void test_08() {
+    // finite coroutines, scheduler returns once all of them are done
+    {
+        rrd_scheduler scheduler;
+        int wakeups = 0;
+        scheduler.spawn(test_08_sleeper(scheduler, wakeups));
+        scheduler.spawn(test_08_sleeper(scheduler, wakeups));
+        assert(scheduler.tasks() == 2);
+        scheduler.run();
+        assert(scheduler.tasks() == 0);
+        assert(wakeups == 6);
+    }
+
+    // stop from another thread while waiting for a distant timer
+    {
+        rrd_scheduler scheduler;
+        int wakeups = 0;
+        scheduler.spawn(test_08_distant_sleeper(scheduler, wakeups));
+        std::thread stopper([&scheduler]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            scheduler.stop();
+        });
+        const auto start = rrd_scheduler::clock::now();
+        scheduler.run();
+        stopper.join();
+        // without waking up, the scheduler would wait for a whole wheel rotation (4 s)
+        assert(rrd_scheduler::clock::now() - start < std::chrono::seconds(1));
+        assert(wakeups == 0);
+        assert(scheduler.tasks() == 1);
+
+        // stop from another thread before running, the next run returns immediately
+        std::thread early_stopper([&scheduler]() {
+            scheduler.stop();
+        });
+        early_stopper.join();
+        const auto early_start = rrd_scheduler::clock::now();
+        scheduler.run();
+        assert(rrd_scheduler::clock::now() - early_start < std::chrono::seconds(1));
+        assert(scheduler.tasks() == 1);
+
+        // the stop request has been consumed, the following run waits until its limit
+        const auto limit = rrd_scheduler::clock::now() + std::chrono::milliseconds(20);
+        scheduler.run_until(limit);
+        assert(rrd_scheduler::clock::now() >= limit);
+        assert(wakeups == 0);
+    }
+
+    // 10k collectors at 1 Hz, spread across the interval
+    const int collectors = 10000;
+    const int samples = 3;
+    const auto interval = std::chrono::seconds(1);
+    rrd_scheduler scheduler;
+    std::vector<rrd_data> data;
+    data.reserve(collectors);
+    rrd_scheduler::clock::duration max_lateness(0);
+    unsigned long long max_skipped = 0;
+    for (int i = 0; i < collectors; ++i) {
+        data.emplace_back("test_08", std::list<rrd_archive>{
+            // archive containing every data point with a maximum size of 5
+            rrd_archive("all", 1, 5, rrd_archive::AVG)
+        });
+        scheduler.spawn(test_08_collector(scheduler, data.back(), interval,
+                                          interval * i / collectors, max_lateness, max_skipped));
+    }
+
+    // stop shortly before the next round of samples
+    const auto start = rrd_scheduler::clock::now();
+    scheduler.run_until(start + interval * samples - std::chrono::milliseconds(1));
+    LOG("maximum lateness of collectors: "
+        << std::chrono::duration_cast<std::chrono::microseconds>(max_lateness).count() << " us");
+    assert(max_lateness < std::chrono::milliseconds(50));
+
+    // a heavily loaded machine may make collectors skip a round
+    assert(max_skipped <= 1);
+
+    // timestamps are exact multiples of the interval apart (exactly one interval unless
+    // a round was skipped), without any drift
+    for (rrd_data const& d : data) {
+        auto const& archive = d.archives().front().archive();
+        assert(archive.size() >= samples - max_skipped && archive.size() <= samples);
+        for (std::size_t i = 1; i < archive.size(); ++i) {
+            const auto diff = archive[i].time() - archive[i - 1].time();
+            assert(diff >= interval && (diff % interval).count() == 0);
+            assert(max_skipped > 0 || diff == interval);
+        }
+    }
+
+    // library provided collector
+    {
+        rrd_scheduler scheduler;
+        rrd_data collected("test_08", std::list<rrd_archive>{
+            rrd_archive("all", 1, 5, rrd_archive::AVG)
+        });
+        int calls = 0;
+        scheduler.spawn(rrd_collect(scheduler, collected, std::chrono::milliseconds(10), [&calls]() {
+            return ++calls;
+        }));
+        scheduler.run_until(rrd_scheduler::clock::now() + std::chrono::milliseconds(35));
+        // 4 calls (at 0, 10, 20 and 30 ms), one less if a wake-up is late
+        assert(calls >= 3 && calls <= 4);
+        std::vector<rrd_data_point::data_point> expected;
+        for (int i = 1; i <= calls; ++i) {
+            expected.push_back(i);
+        }
+        assert_equal_content(expected, collected.archives().front());
+    }
+}
+
+/// write content to a file, replacing previous content
+void write_file(std::string const& path, std::string const& content) {
+    std::ofstream out(path, std::ios::trunc);
+    assert(out);
+    out << content;
+}
+
+/// test collectors of files within /proc, using files with known content
+void test_09() {
+    const std::string stat = "test_09_stat";
+    const std::string meminfo = "test_09_meminfo";
+    const std::string diskstats = "test_09_diskstats";
+    const std::string netdev = "test_09_netdev";
+
+    // file content is reread from the start, growing the buffer if necessary
+    write_file(stat, "0123456789");
+    rrd_proc_file file(stat, 4);
+    assert(file.is_open());
+    assert(file.read() == "0123456789");
+    write_file(stat, "abc");
+    assert(file.read() == "abc");
+    rrd_proc_file empty_buffer(stat, 0);
+    assert(empty_buffer.read() == "abc");
+    assert(!rrd_proc_file("test_09_missing").is_open());
+    assert(rrd_proc_file("test_09_missing").read().empty());
+
+    // CPU usage
+    write_file(stat,
+        "cpu  100 0 100 800 0 0 0 0 0 0\n"
+        "cpu0 50 0 50 400 0 0 0 0 0 0\n"
+        "cpu1 50 0 50 400 0 0 0 0 0 0\n"
+        "intr 1234 0 0\n");
+    rrd_proc_cpu cpu(stat);
+    assert((cpu.names() == std::vector<std::string>{"cpu", "cpu0", "cpu1"}));
+    assert(cpu.sample());
+    for (rrd_data_point::data_point v : cpu.values()) {
+        assert(std::isnan(v));
+    }
+    write_file(stat,
+        "cpu  200 0 150 850 0 0 0 0 0 0\n"
+        "cpu0 100 0 100 400 0 0 0 0 0 0\n"
+        "cpu1 100 0 50 450 0 0 0 0 0 0\n"
+        "intr 1234 0 0\n");
+    assert(cpu.sample());
+    assert(almost_equal(cpu.values()[0], 75.0));
+    assert(almost_equal(cpu.values()[1], 100.0));
+    assert(almost_equal(cpu.values()[2], 50.0));
+
+    // idle CPU (cpu0) has 0 % usage
+    write_file(stat,
+        "cpu  250 0 150 950 50 0 0 0 0 0\n"
+        "cpu0 100 0 100 500 0 0 0 0 0 0\n"
+        "cpu1 150 0 50 450 50 0 0 0 0 0\n"
+        "intr 1234 0 0\n");
+    assert(cpu.sample());
+    assert(almost_equal(cpu.values()[0], 50.0));
+    assert(almost_equal(cpu.values()[1], 0.0));
+    assert(almost_equal(cpu.values()[2], 100.0));
+
+    // unchanged (cpu0) and decreasing counters (iowait of cpu1) result in unknown usage
+    write_file(stat,
+        "cpu  300 0 150 1050 50 0 0 0 0 0\n"
+        "cpu0 100 0 100 500 0 0 0 0 0 0\n"
+        "cpu1 150 0 50 455 40 0 0 0 0 0\n"
+        "intr 1234 0 0\n");
+    assert(cpu.sample());
+    assert(almost_equal(cpu.values()[0], 33.33));
+    assert(std::isnan(cpu.values()[1]));
+    assert(std::isnan(cpu.values()[2]));
+
+    // feed all series in one batch
+    std::vector<rrd_data> cpu_data = cpu.create_data(std::list<rrd_archive>{
+        rrd_archive("all", 1, 5, rrd_archive::AVG)
+    });
+    assert(cpu_data.size() == 3 && cpu_data[2].name() == "cpu1");
+    cpu.add(cpu_data, rrd_data_point::time_point());
+    assert(cpu_data[2].archives().front().archive()[0].is_unknown());
+
+    // memory information, missing keys are unknown
+    write_file(meminfo,
+        "MemTotal:       16000000 kB\n"
+        "MemFree:         1000000 kB\n"
+        "MemAvailable:    8000000 kB\n"
+        "Buffers:          500000 kB\n"
+        "Cached:          4000000 kB\n");
+    rrd_proc_meminfo mem(std::vector<std::string>{"MemAvailable", "Buffers", "Cached", "Missing"}, meminfo);
+    assert(mem.sample());
+    assert(almost_equal(mem.values()[0], 8000000));
+    assert(almost_equal(mem.values()[1], 500000));
+    assert(almost_equal(mem.values()[2], 4000000));
+    assert(std::isnan(mem.values()[3]));
+
+    // disk statistics, differences in bytes
+    write_file(diskstats,
+        "   8       0 sda 100 0 2000 0 50 0 1000 0 0 0 0\n"
+        "   8       1 sda1 10 0 200 0 5 0 100 0 0 0 0\n");
+    rrd_proc_diskstats disk(diskstats);
+    assert((disk.names() == std::vector<std::string>{"sda_read", "sda_written", "sda1_read", "sda1_written"}));
+    assert(disk.sample());
+    assert(std::isnan(disk.values()[0]));
+    write_file(diskstats,
+        "   8       0 sda 110 0 2010 0 60 0 1020 0 0 0 0\n");
+    assert(disk.sample());
+    assert(almost_equal(disk.values()[0], 10 * 512));
+    assert(almost_equal(disk.values()[1], 20 * 512));
+    // removed device is unknown
+    assert(std::isnan(disk.values()[2]) && std::isnan(disk.values()[3]));
+    // reset counters (e.g. device re-plugged) are unknown instead of wrapping around
+    write_file(diskstats,
+        "   8       0 sda 5 0 20 0 60 0 1030 0 0 0 0\n");
+    assert(disk.sample());
+    assert(std::isnan(disk.values()[0]));
+    assert(almost_equal(disk.values()[1], 10 * 512));
+    write_file(diskstats,
+        "   8       0 sda 6 0 30 0 60 0 1030 0 0 0 0\n");
+    assert(disk.sample());
+    assert(almost_equal(disk.values()[0], 10 * 512));
+
+    // network interfaces, differences in bytes
+    write_file(netdev,
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+        "    lo:    1000      10    0    0    0     0          0         0     1000      10    0    0    0     0       0          0\n"
+        "  eth0:    5000      50    0    0    0     0          0         0     3000      30    0    0    0     0       0          0\n");
+    rrd_proc_netdev net(netdev);
+    assert((net.names() == std::vector<std::string>{"lo_rx", "lo_tx", "eth0_rx", "eth0_tx"}));
+    assert(net.sample());
+    write_file(netdev,
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+        "  eth0:    5500      55    0    0    0     0          0         0     3300      33    0    0    0     0       0          0\n"
+        "    lo:    1000      10    0    0    0     0          0         0     1000      10    0    0    0     0       0          0\n");
+    assert(net.sample());
+    assert(almost_equal(net.values()[0], 0) && almost_equal(net.values()[1], 0));
+    assert(almost_equal(net.values()[2], 500) && almost_equal(net.values()[3], 300));
+
+    std::remove(stat.c_str());
+    std::remove(meminfo.c_str());
+    std::remove(diskstats.c_str());
+    std::remove(netdev.c_str());
+}
+
+/// test consolidation of many PDPs against a simple loop
+void test_10() {
+    const rrd_data_point::data_point u = rrd_data_point::unknown;
+    const rrd_data_point::data_point inf = std::numeric_limits<rrd_data_point::data_point>::infinity();
+
+    // PDPs equal to the initial minimum/maximum (+inf/-inf)
+    rrd_data data("test_10", std::list<rrd_archive>{
+        rrd_archive("min", 4, 1, rrd_archive::MIN),
+        rrd_archive("max", 4, 1, rrd_archive::MAX)
+    });
+    const rrd_data_point::time_point t;
+    for (int i = 0; i < 4; ++i) {
+        data.add(inf, t + rrd_archive::dump_resolution(i));
+    }
+    rrd_archive const& min_rra = data.archives().front();
+    assert(min_rra.archive().size() == 1);
+    assert(min_rra.archive()[0].value() == inf);
+    assert(min_rra.archive()[0].time() == t);
+    for (int i = 0; i < 4; ++i) {
+        data.add(-inf, t + rrd_archive::dump_resolution(i));
+    }
+    rrd_archive const& max_rra = data.archives().back();
+    assert(max_rra.archive()[0].value() == -inf);
+    assert(max_rra.archive()[0].time() == t);
+
+    // consolidation of more PDPs than processed at once, compared against a simple loop,
+    // with unknown PDPs, infinite PDPs, repeated minimum/maximum and
+    // remaining PDPs after the last full block
+    const std::vector<rrd_data_point::data_point> candidates{u, -inf, -1.0, 0.0, 1.0, 2.0, inf};
+    unsigned int seed = 1;
+    for (int round = 0; round < 2000; ++round) {
+        const std::size_t size = 1 + round % 13;
+        rrd_archive rra("consolidate", size, 1, rrd_archive::AVG, 0.99);
+        for (std::size_t i = 0; i < size; ++i) {
+            seed = seed * 1103515245 + 12345;
+            const rrd_data_point::data_point v = candidates[(seed >> 16) % candidates.size()];
+            rra.values_.push_back(v);
+            rra.times_.push_back(t);
+            rra.unknowns_ += std::isnan(v);
+        }
+        if (rra.unknowns_ == size) {
+            assert(rra.min() == size && rra.max() == size);
+            continue;
+        }
+
+        std::size_t min_index = size, max_index = size;
+        rrd_data_point::data_point sum = 0.0;
+        for (std::size_t i = 0; i < size; ++i) {
+            const rrd_data_point::data_point v = rra.values_[i];
+            if (std::isnan(v)) {
+                continue;
+            }
+            sum += v;
+            if (min_index == size || v < rra.values_[min_index]) {
+                min_index = i;
+            }
+            if (max_index == size || v > rra.values_[max_index]) {
+                max_index = i;
+            }
+        }
+        assert(rra.min() == min_index);
+        assert(rra.max() == max_index);
+        const rrd_data_point::data_point avg = sum / (size - rra.unknowns_);
+        assert(rra.avg() == avg || (std::isnan(rra.avg()) && std::isnan(avg)) || almost_equal(rra.avg(), avg));
+    }
+}
+
 int main() {
     test_01();
     test_02();
     test_03();
     test_04();
+    test_05();
+    test_06();
+    test_07();
+    test_08();
+    test_09();
+    test_10();
 
     std::cout << "All tests done." << std::endl;
 }
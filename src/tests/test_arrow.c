@@ -0,0 +1,66 @@
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "librrd_arrow.h"
+
+/// validate RRA entries exported via the Arrow C data interface, as seen by a C consumer,
+/// expects NaN (unknown) values to be exported as NaN, releases schema and array afterwards
+/// (moving one child out of the array before)
+void check_arrow_export(struct ArrowSchema* schema, struct ArrowArray* array,
+                        const char* name, const double* values, const int64_t* times, int64_t n) {
+    int64_t i;
+
+    // check schema: struct<time: timestamp[ns, UTC], value: float64>
+    assert(schema->release != NULL);
+    assert(strcmp(schema->format, "+s") == 0);
+    assert(strcmp(schema->name, name) == 0);
+    assert(schema->n_children == 2);
+    assert(strcmp(schema->children[0]->format, "tsn:UTC") == 0);
+    assert(strcmp(schema->children[0]->name, "time") == 0);
+    assert(strcmp(schema->children[1]->format, "g") == 0);
+    assert(strcmp(schema->children[1]->name, "value") == 0);
+
+    // check array
+    assert(array->release != NULL);
+    assert(array->length == n);
+    assert(array->null_count == 0);
+    assert(array->n_buffers == 1);
+    assert(array->buffers[0] == NULL);
+    assert(array->n_children == 2);
+    for (i = 0; i < 2; ++i) {
+        assert(array->children[i]->length == n);
+        assert(array->children[i]->offset == 0);
+        assert(array->children[i]->n_buffers == 2);
+        assert(array->children[i]->buffers[0] == NULL);
+    }
+
+    // check buffers: exported without copying, content equals the expected entries
+    const int64_t* time_buf = (const int64_t*)array->children[0]->buffers[1];
+    const double* value_buf = (const double*)array->children[1]->buffers[1];
+    for (i = 0; i < n; ++i) {
+        assert(time_buf[i] == times[i]);
+        if (isnan(values[i])) {
+            assert(isnan(value_buf[i]));
+        } else {
+            assert(fabs(value_buf[i] - values[i]) < 0.01);
+        }
+    }
+
+    // move value child out of the parent, it has to stay valid after releasing the parent
+    struct ArrowArray moved = *array->children[1];
+    array->children[1]->release = NULL;
+
+    array->release(array);
+    assert(array->release == NULL);
+
+    assert(moved.length == n);
+    assert(moved.buffers[0] == NULL);
+    assert(moved.buffers[1] == value_buf);
+    moved.release(&moved);
+    assert(moved.release == NULL);
+
+    schema->release(schema);
+    assert(schema->release == NULL);
+}